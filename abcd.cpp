@@ -2,89 +2,1170 @@
 #include <cstdlib>
 #include <ctime>
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+#include <cmath>
+#include <stdexcept>
+#include "pool_allocator.h"
 
-// Behavior Tree Node Interface
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class BehaviorTreeCompiler;
+class EventDrivenTree;
+
+// Result of ticking a node. Running means the node has more work to do and
+// wants to be ticked again next frame, continuing where it left off.
+enum NodeStatus : uint8_t {
+    NODE_FAILURE,
+    NODE_SUCCESS,
+    NODE_RUNNING
+};
+
+// Bytes of values an agent's blackboard holds (Blackboard::CAPACITY)
+const size_t BLACKBOARD_CAPACITY = 56;
+
+// Blackboard key known at compile time: the value type, its byte offset in the agent's
+// block and its change bit. Declare keys in order so each offset is aligned after the last:
+//   constexpr BlackboardKey<bool> ENEMY_VISIBLE = firstKey<bool>();
+//   constexpr BlackboardKey<float> ENEMY_DISTANCE = keyAfter<float>(ENEMY_VISIBLE);
+// A key that would not fit the block, or would need a change bit past 63, does not compile.
+template <class T>
+struct BlackboardKey {
+    typedef T Type;
+    uint16_t offset;
+    uint8_t bit;
+
+    constexpr uint64_t mask() const {
+        return uint64_t(1) << bit;
+    }
+
+    constexpr size_t end() const {
+        return offset + sizeof(T);
+    }
+};
+
+// Throwing makes an out-of-range key a compile error wherever the key is constexpr
+template <class T>
+constexpr BlackboardKey<T> checkedKey(size_t offset, unsigned bit) {
+    if (offset + sizeof(T) > BLACKBOARD_CAPACITY)
+        throw std::length_error("blackboard key does not fit the blackboard");
+    if (bit > 63)
+        throw std::length_error("blackboard has no change bit left for the key");
+    return {(uint16_t)offset, (uint8_t)bit};
+}
+
+template <class T>
+constexpr BlackboardKey<T> firstKey() {
+    return checkedKey<T>(0, 0);
+}
+
+template <class T, class Previous>
+constexpr BlackboardKey<T> keyAfter(BlackboardKey<Previous> previous) {
+    return checkedKey<T>((previous.end() + alignof(T) - 1) / alignof(T) * alignof(T), previous.bit + 1u);
+}
+
+// Per-agent blackboard: a plain 64-byte block holding each value at its key's offset and a
+// bit per key that is set when the value changes. Reads and writes are fixed-offset copies,
+// so an array of these is the agents' shared state with no hashing or allocation per agent.
+// Value-initialise (Blackboard{} or a std::vector) to start with every value zero.
+struct Blackboard {
+    static constexpr size_t CAPACITY = BLACKBOARD_CAPACITY;
+
+    alignas(8) unsigned char data[CAPACITY];
+    uint64_t changed;   // bit per key, set by set() when the value differs
+
+    template <class T>
+    T get(BlackboardKey<T> key) const {
+        static_assert(std::is_trivially_copyable<T>::value, "blackboard values must be plain data");
+        T value;
+        memcpy(&value, data + key.offset, sizeof(T));
+        return value;
+    }
+
+    template <class T>
+    void set(BlackboardKey<T> key, const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "blackboard values must be plain data");
+        if (memcmp(data + key.offset, &value, sizeof(T)) == 0)
+            return;
+        memcpy(data + key.offset, &value, sizeof(T));
+        changed |= key.mask();
+    }
+
+    // Returns which keys in `mask` changed since the last call, and clears them
+    uint64_t consumeChanges(uint64_t mask) {
+        uint64_t hits = changed & mask;
+        changed &= ~mask;
+        return hits;
+    }
+};
+
+static_assert(sizeof(Blackboard) == 64, "a blackboard should fill one cache line");
+
+// Marks a condition that reads a fixed value rather than a blackboard key
+constexpr BlackboardKey<bool> NO_BLACKBOARD_KEY = {0, 0xFF};
+
+// Float lanes for utility scoring: 8 wide with AVX2, 4 with SSE2, one float otherwise.
+// Comparisons give a lane mask that lanesSelect() uses to pick from its first argument.
+#if defined(__AVX2__)
+typedef __m256 FloatLanes;
+const int LANE_COUNT = 8;
+
+inline FloatLanes lanesLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void lanesStore(float* p, FloatLanes v) { _mm256_storeu_ps(p, v); }
+inline FloatLanes lanesSet(float x) { return _mm256_set1_ps(x); }
+inline FloatLanes lanesAdd(FloatLanes a, FloatLanes b) { return _mm256_add_ps(a, b); }
+inline FloatLanes lanesSub(FloatLanes a, FloatLanes b) { return _mm256_sub_ps(a, b); }
+inline FloatLanes lanesMul(FloatLanes a, FloatLanes b) { return _mm256_mul_ps(a, b); }
+inline FloatLanes lanesDiv(FloatLanes a, FloatLanes b) { return _mm256_div_ps(a, b); }
+inline FloatLanes lanesMin(FloatLanes a, FloatLanes b) { return _mm256_min_ps(a, b); }
+inline FloatLanes lanesMax(FloatLanes a, FloatLanes b) { return _mm256_max_ps(a, b); }
+inline FloatLanes lanesGreater(FloatLanes a, FloatLanes b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+inline FloatLanes lanesSelect(FloatLanes mask, FloatLanes a, FloatLanes b) { return _mm256_blendv_ps(b, a, mask); }
+inline FloatLanes lanesFloor(FloatLanes x) { return _mm256_floor_ps(x); }
+
+// 2^n for whole n in [-126, 127], built directly in the exponent bits
+inline FloatLanes lanesPow2(FloatLanes n) {
+    __m256i bits = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+}
+#elif defined(__SSE2__)
+typedef __m128 FloatLanes;
+const int LANE_COUNT = 4;
+
+inline FloatLanes lanesLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void lanesStore(float* p, FloatLanes v) { _mm_storeu_ps(p, v); }
+inline FloatLanes lanesSet(float x) { return _mm_set1_ps(x); }
+inline FloatLanes lanesAdd(FloatLanes a, FloatLanes b) { return _mm_add_ps(a, b); }
+inline FloatLanes lanesSub(FloatLanes a, FloatLanes b) { return _mm_sub_ps(a, b); }
+inline FloatLanes lanesMul(FloatLanes a, FloatLanes b) { return _mm_mul_ps(a, b); }
+inline FloatLanes lanesDiv(FloatLanes a, FloatLanes b) { return _mm_div_ps(a, b); }
+inline FloatLanes lanesMin(FloatLanes a, FloatLanes b) { return _mm_min_ps(a, b); }
+inline FloatLanes lanesMax(FloatLanes a, FloatLanes b) { return _mm_max_ps(a, b); }
+inline FloatLanes lanesGreater(FloatLanes a, FloatLanes b) { return _mm_cmpgt_ps(a, b); }
+inline FloatLanes lanesSelect(FloatLanes mask, FloatLanes a, FloatLanes b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+inline FloatLanes lanesFloor(FloatLanes x) {
+    FloatLanes truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+// 2^n for whole n in [-126, 127], built directly in the exponent bits
+inline FloatLanes lanesPow2(FloatLanes n) {
+    __m128i bits = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+    return _mm_castsi128_ps(_mm_slli_epi32(bits, 23));
+}
+#else
+typedef float FloatLanes;
+const int LANE_COUNT = 1;
+
+inline FloatLanes lanesLoad(const float* p) { return *p; }
+inline void lanesStore(float* p, FloatLanes v) { *p = v; }
+inline FloatLanes lanesSet(float x) { return x; }
+inline FloatLanes lanesAdd(FloatLanes a, FloatLanes b) { return a + b; }
+inline FloatLanes lanesSub(FloatLanes a, FloatLanes b) { return a - b; }
+inline FloatLanes lanesMul(FloatLanes a, FloatLanes b) { return a * b; }
+inline FloatLanes lanesDiv(FloatLanes a, FloatLanes b) { return a / b; }
+inline FloatLanes lanesMin(FloatLanes a, FloatLanes b) { return std::min(a, b); }
+inline FloatLanes lanesMax(FloatLanes a, FloatLanes b) { return std::max(a, b); }
+inline FloatLanes lanesGreater(FloatLanes a, FloatLanes b) { return a > b ? 1.0f : 0.0f; }
+inline FloatLanes lanesSelect(FloatLanes mask, FloatLanes a, FloatLanes b) { return mask != 0.0f ? a : b; }
+inline FloatLanes lanesFloor(FloatLanes x) { return std::floor(x); }
+inline FloatLanes lanesPow2(FloatLanes n) { return std::ldexp(1.0f, (int)n); }
+#endif
+
+inline FloatLanes lanesClamp01(FloatLanes x) {
+    return lanesMin(lanesMax(x, lanesSet(0.0f)), lanesSet(1.0f));
+}
+
+// e^x to about 1e-6 relative error: 2^(x log2 e) split into a whole power of two
+// and a polynomial for 2^f on [0, 1)
+inline FloatLanes lanesExp(FloatLanes x) {
+    x = lanesMin(lanesMax(x, lanesSet(-80.0f)), lanesSet(80.0f));
+    FloatLanes t = lanesMul(x, lanesSet(1.44269504f));
+    FloatLanes n = lanesFloor(t);
+    FloatLanes f = lanesSub(t, n);
+    FloatLanes p = lanesSet(1.8775767e-3f);
+    p = lanesAdd(lanesMul(p, f), lanesSet(8.9893397e-3f));
+    p = lanesAdd(lanesMul(p, f), lanesSet(5.5826318e-2f));
+    p = lanesAdd(lanesMul(p, f), lanesSet(2.4015361e-1f));
+    p = lanesAdd(lanesMul(p, f), lanesSet(6.9315308e-1f));
+    p = lanesAdd(lanesMul(p, f), lanesSet(9.9999994e-1f));
+    return lanesMul(p, lanesPow2(n));
+}
+
+// Response curve over an input normalised to [0, 1]; the output is clamped to [0, 1].
+//   polynomial: y = slope * (x - xShift)^power + yShift   (power 1 is linear)
+//   logistic:   y = 1 / (1 + e^(-slope * (x - xShift))) + yShift
+enum CurveType : uint8_t {
+    CURVE_POLYNOMIAL,
+    CURVE_LOGISTIC
+};
+
+struct ResponseCurve {
+    CurveType type;
+    int power;
+    float slope;
+    float xShift;
+    float yShift;
+};
+
+inline FloatLanes evaluateCurve(const ResponseCurve& curve, FloatLanes x) {
+    FloatLanes d = lanesSub(x, lanesSet(curve.xShift));
+    FloatLanes y;
+    if (curve.type == CURVE_LOGISTIC) {
+        FloatLanes e = lanesExp(lanesMul(lanesSet(-curve.slope), d));
+        y = lanesDiv(lanesSet(1.0f), lanesAdd(lanesSet(1.0f), e));
+    } else {
+        FloatLanes p = d;
+        for (int k = 1; k < curve.power; ++k) {
+            p = lanesMul(p, d);
+        }
+        y = lanesMul(lanesSet(curve.slope), p);
+    }
+    return lanesClamp01(lanesAdd(y, lanesSet(curve.yShift)));
+}
+
+// One input to an action's score: a float blackboard value mapped from [rangeMin, rangeMax]
+// onto [0, 1] and then through a response curve
+struct Consideration {
+    BlackboardKey<float> input;
+    float rangeMin;
+    float rangeMax;
+    ResponseCurve curve;
+};
+
+// Scores as weight times the product of its considerations
+struct UtilityAction {
+    std::string name;
+    float weight;
+    std::vector<Consideration> considerations;
+};
+
+// Picks the best-scoring action for agents. Scoring runs over lanes of agents at a time:
+// each chunk of agents has its inputs gathered into one row per blackboard key, every
+// action is scored across the lanes, and a running max and argmax stay in registers.
+// The first action wins ties. choose() and chooseBatch() are safe to call concurrently.
+class UtilityScorer {
+public:
+    static const int MAX_INPUTS = Blackboard::CAPACITY / sizeof(float);
+    static const int MAX_ACTIONS = 255;   // so a choice fits in a byte
+
+    UtilityScorer() : firstTerm(1, 0), inputBits(0) {}
+
+    bool addAction(const UtilityAction& action) {
+        if ((int)weights.size() == MAX_ACTIONS) {
+            std::cerr << "Utility scorer already has " << MAX_ACTIONS << " actions" << std::endl;
+            return false;
+        }
+        std::vector<Term> added;
+        std::vector<BlackboardKey<float>> keys = inputs;
+        for (const Consideration& c : action.considerations) {
+            size_t slot = 0;
+            while (slot < keys.size() && keys[slot].offset != c.input.offset) {
+                ++slot;
+            }
+            if (slot == keys.size()) {
+                if ((int)keys.size() == MAX_INPUTS) {
+                    std::cerr << "Utility action " << action.name << " reads too many inputs" << std::endl;
+                    return false;
+                }
+                keys.push_back(c.input);
+            }
+            float range = c.rangeMax - c.rangeMin;
+            added.push_back({(int)slot, c.rangeMin, range != 0.0f ? 1.0f / range : 0.0f, c.curve});
+        }
+
+        inputs = keys;
+        names.push_back(action.name);
+        weights.push_back(action.weight);
+        terms.insert(terms.end(), added.begin(), added.end());
+        firstTerm.push_back(terms.size());
+        for (const Consideration& c : action.considerations) {
+            inputBits |= c.input.mask();
+        }
+        return true;
+    }
+
+    int actionCount() const {
+        return weights.size();
+    }
+
+    const std::string& actionName(int action) const {
+        return names[action];
+    }
+
+    // Change bits of every key the scores read
+    uint64_t inputMask() const {
+        return inputBits;
+    }
+
+    int choose(const Blackboard& blackboard) const {
+        uint32_t agent = 0;
+        uint8_t choice;
+        chooseBatch(&blackboard, &agent, 1, &choice);
+        return choice;
+    }
+
+    // choices[k] = best action for blackboards[agents[k]]
+    void chooseBatch(const Blackboard* blackboards, const uint32_t* agents, int count, uint8_t* choices) const {
+        const int CHUNK = 64;
+        alignas(32) float values[MAX_INPUTS * CHUNK];
+        alignas(32) float chosen[CHUNK];
+
+        for (int base = 0; base < count; base += CHUNK) {
+            int n = std::min(CHUNK, count - base);
+            int padded = (n + LANE_COUNT - 1) / LANE_COUNT * LANE_COUNT;
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                float* row = values + i * CHUNK;
+                for (int k = 0; k < n; ++k) {
+                    row[k] = blackboards[agents[base + k]].get(inputs[i]);
+                }
+                std::fill(row + n, row + padded, 0.0f);
+            }
+
+            for (int k = 0; k < padded; k += LANE_COUNT) {
+                FloatLanes best = lanesSet(-1.0f);
+                FloatLanes bestAction = lanesSet(0.0f);
+                for (size_t a = 0; a < weights.size(); ++a) {
+                    FloatLanes score = lanesSet(weights[a]);
+                    for (int t = firstTerm[a]; t < firstTerm[a + 1]; ++t) {
+                        const Term& term = terms[t];
+                        FloatLanes x = lanesLoad(values + term.input * CHUNK + k);
+                        x = lanesClamp01(lanesMul(lanesSub(x, lanesSet(term.rangeMin)), lanesSet(term.invRange)));
+                        score = lanesMul(score, evaluateCurve(term.curve, x));
+                    }
+                    FloatLanes better = lanesGreater(score, best);
+                    best = lanesSelect(better, score, best);
+                    bestAction = lanesSelect(better, lanesSet((float)a), bestAction);
+                }
+                lanesStore(chosen + k, bestAction);
+            }
+
+            for (int k = 0; k < n; ++k) {
+                choices[base + k] = (uint8_t)chosen[k];
+            }
+        }
+    }
+
+private:
+    struct Term {
+        int input;        // row in the gathered inputs
+        float rangeMin;
+        float invRange;
+        ResponseCurve curve;
+    };
+
+    std::vector<std::string> names;
+    std::vector<float> weights;
+    std::vector<int> firstTerm;   // terms of action a are [firstTerm[a], firstTerm[a + 1])
+    std::vector<Term> terms;
+    std::vector<BlackboardKey<float>> inputs;
+    uint64_t inputBits;
+};
+
+// Behavior Tree Node Interface. Node classes allocate from per-class pools (Pooled), and a
+// composite owns its children: deleting the root frees the whole tree.
 class BehaviorNode {
 public:
     virtual ~BehaviorNode() {}
-    virtual bool execute() = 0;
+    virtual NodeStatus execute() = 0;
+    virtual void compile(BehaviorTreeCompiler& compiler) const = 0;
+
+    // Drops any Running progress so the next execute() starts afresh
+    virtual void reset() {}
+
+    // Adds the change bits of the blackboard keys this subtree reads
+    virtual void collectKeys(uint64_t&) const {}
 };
 
-// Action Node
-class ActionNode : public BehaviorNode {
+// Action Node; takes `ticks` executions to complete and is Running until then
+class ActionNode : public BehaviorNode, public Pooled<ActionNode, false, MEM_AI> {
 public:
-    ActionNode(const std::string& actionName) : actionName(actionName) {}
+    ActionNode(const std::string& actionName, int ticks = 1) : actionName(actionName), ticks(ticks) {}
 
-    bool execute() override {
+    NodeStatus execute() override {
         std::cout << "Executing Action: " << actionName << std::endl;
-        return true;  // In a real scenario, this could return success/failure based on the action.
+        if (++progress < ticks) {
+            return NODE_RUNNING;
+        }
+        progress = 0;
+        return NODE_SUCCESS;  // In a real scenario, this could return success/failure based on the action.
     }
 
+    void reset() override {
+        progress = 0;
+    }
+
+    void compile(BehaviorTreeCompiler& compiler) const override;
+
 private:
     std::string actionName;
+    int ticks;
+    int progress = 0;
 };
 
-// Condition Node
-class ConditionNode : public BehaviorNode {
+// Condition Node; reads either a fixed value or a bool blackboard key. A tree that is
+// only compiled may leave out the blackboard: the leaf handler reads each agent's own.
+class ConditionNode : public BehaviorNode, public Pooled<ConditionNode, false, MEM_AI> {
 public:
-    ConditionNode(const std::string& conditionName, bool condition) : conditionName(conditionName), condition(condition) {}
+    ConditionNode(const std::string& conditionName, bool condition)
+        : conditionName(conditionName), condition(condition), blackboard(nullptr), key(NO_BLACKBOARD_KEY) {}
 
-    bool execute() override {
+    ConditionNode(const std::string& conditionName, BlackboardKey<bool> key, const Blackboard* blackboard = nullptr)
+        : conditionName(conditionName), condition(false), blackboard(blackboard), key(key) {}
+
+    NodeStatus execute() override {
         std::cout << "Checking Condition: " << conditionName << std::endl;
-        return condition;
+        bool value = blackboard ? blackboard->get(key) : condition;
+        return value ? NODE_SUCCESS : NODE_FAILURE;
     }
 
+    void collectKeys(uint64_t& mask) const override {
+        if (key.bit != NO_BLACKBOARD_KEY.bit) {
+            mask |= key.mask();
+        }
+    }
+
+    void compile(BehaviorTreeCompiler& compiler) const override;
+
 private:
     std::string conditionName;
     bool condition;
+    const Blackboard* blackboard;
+    BlackboardKey<bool> key;
 };
 
-// Sequence Node
-class SequenceNode : public BehaviorNode {
+// Sequence Node; a Running child is resumed on the next tick instead of restarting the sequence
+class SequenceNode : public BehaviorNode, public Pooled<SequenceNode, false, MEM_AI> {
 public:
     SequenceNode(const std::string& sequenceName) : sequenceName(sequenceName) {}
 
+    ~SequenceNode() override {
+        for (BehaviorNode* child : children) {
+            delete child;
+        }
+    }
+
     void addChild(BehaviorNode* child) {
         children.push_back(child);
     }
 
-    bool execute() override {
+    NodeStatus execute() override {
         std::cout << "Executing Sequence: " << sequenceName << std::endl;
-        for (BehaviorNode* child : children) {
-            if (!child->execute()) {
-                return false;
+        for (; current < children.size(); ++current) {
+            NodeStatus status = children[current]->execute();
+            if (status == NODE_RUNNING) {
+                return NODE_RUNNING;
+            }
+            if (status == NODE_FAILURE) {
+                current = 0;
+                return NODE_FAILURE;
             }
         }
-        return true;
+        current = 0;
+        return NODE_SUCCESS;
+    }
+
+    void reset() override {
+        current = 0;
+        for (BehaviorNode* child : children) {
+            child->reset();
+        }
+    }
+
+    void collectKeys(uint64_t& mask) const override {
+        for (BehaviorNode* child : children) {
+            child->collectKeys(mask);
+        }
     }
 
+    void compile(BehaviorTreeCompiler& compiler) const override;
+
 private:
     std::string sequenceName;
     std::vector<BehaviorNode*> children;
+    size_t current = 0;   // child to resume after Running
 };
 
-// Selector Node
-class SelectorNode : public BehaviorNode {
+// Selector Node; a Running child is resumed on the next tick instead of restarting the selector
+class SelectorNode : public BehaviorNode, public Pooled<SelectorNode, false, MEM_AI> {
 public:
     SelectorNode(const std::string& selectorName) : selectorName(selectorName) {}
 
+    ~SelectorNode() override {
+        for (BehaviorNode* child : children) {
+            delete child;
+        }
+    }
+
     void addChild(BehaviorNode* child) {
         children.push_back(child);
     }
 
-    bool execute() override {
+    NodeStatus execute() override {
         std::cout << "Executing Selector: " << selectorName << std::endl;
-        for (BehaviorNode* child : children) {
-            if (child->execute()) {
-                return true;
+        for (; current < children.size(); ++current) {
+            NodeStatus status = children[current]->execute();
+            if (status == NODE_RUNNING) {
+                return NODE_RUNNING;
+            }
+            if (status == NODE_SUCCESS) {
+                current = 0;
+                return NODE_SUCCESS;
             }
         }
-        return false;
+        current = 0;
+        return NODE_FAILURE;
     }
 
+    void reset() override {
+        current = 0;
+        for (BehaviorNode* child : children) {
+            child->reset();
+        }
+    }
+
+    void collectKeys(uint64_t& mask) const override {
+        for (BehaviorNode* child : children) {
+            child->collectKeys(mask);
+        }
+    }
+
+    void compile(BehaviorTreeCompiler& compiler) const override;
+
+private:
+    std::string selectorName;
+    std::vector<BehaviorNode*> children;
+    size_t current = 0;   // child to resume after Running
+};
+
+// Selector that runs the child whose utility action scores highest on the blackboard.
+// A Running child keeps the selector committed to it until it finishes; otherwise the
+// choice is made afresh on every tick. A tree that is only compiled may leave out the
+// blackboard, as with ConditionNode.
+class UtilitySelectorNode : public BehaviorNode, public Pooled<UtilitySelectorNode, false, MEM_AI> {
+public:
+    UtilitySelectorNode(const std::string& selectorName, const Blackboard* blackboard = nullptr)
+        : selectorName(selectorName), blackboard(blackboard) {}
+
+    ~UtilitySelectorNode() override {
+        for (BehaviorNode* child : children) {
+            delete child;
+        }
+    }
+
+    bool addChild(BehaviorNode* child, const UtilityAction& action) {
+        if (!scorer.addAction(action)) {
+            return false;
+        }
+        children.push_back(child);
+        return true;
+    }
+
+    NodeStatus execute() override {
+        std::cout << "Executing Utility Selector: " << selectorName << std::endl;
+        if (children.empty()) {
+            return NODE_FAILURE;
+        }
+        if (!running) {
+            Blackboard empty = {};
+            current = scorer.choose(blackboard ? *blackboard : empty);
+        }
+        NodeStatus status = children[current]->execute();
+        running = status == NODE_RUNNING;
+        return status;
+    }
+
+    void reset() override {
+        running = false;
+        for (BehaviorNode* child : children) {
+            child->reset();
+        }
+    }
+
+    void collectKeys(uint64_t& mask) const override {
+        mask |= scorer.inputMask();
+        for (BehaviorNode* child : children) {
+            child->collectKeys(mask);
+        }
+    }
+
+    void compile(BehaviorTreeCompiler& compiler) const override;
+
 private:
     std::string selectorName;
+    const Blackboard* blackboard;
     std::vector<BehaviorNode*> children;
+    UtilityScorer scorer;
+    size_t current = 0;
+    bool running = false;
+};
+
+// Event-driven tick for one agent. The tree watches the change bits of every blackboard
+// key its conditions read. A tree that finished stays finished, costing one mask test per
+// tick, until one of those keys changes; it is then re-evaluated from the root, which also
+// lets a higher-priority branch take over from a Running one. A Running tree resumes.
+class EventDrivenTree {
+public:
+    EventDrivenTree(BehaviorNode& root, Blackboard& blackboard)
+        : root(root), blackboard(blackboard), watched(0), status(NODE_FAILURE), evaluated(false) {
+        root.collectKeys(watched);
+    }
+
+    // Returns true if the tree did any work this tick
+    bool tick() {
+        if (blackboard.consumeChanges(watched) != 0 || !evaluated) {
+            evaluated = true;
+            root.reset();
+        } else if (status != NODE_RUNNING) {
+            return false;
+        }
+        status = root.execute();
+        return true;
+    }
+
+    NodeStatus lastStatus() const {
+        return status;
+    }
+
+private:
+    BehaviorNode& root;
+    Blackboard& blackboard;
+    uint64_t watched;
+    NodeStatus status;
+    bool evaluated;
+};
+
+// Compiled behavior tree: nodes in pre-order in one array. A composite's children follow
+// it directly and `skip` is the index just past its subtree, so the interpreter walks the
+// array with a small stack of open composites instead of recursing through virtual calls.
+enum FlatNodeType : uint16_t {
+    FLAT_ACTION,
+    FLAT_CONDITION,
+    FLAT_SEQUENCE,
+    FLAT_SELECTOR,
+    FLAT_UTILITY     // runs the child its utility scorer picks; leaf indexes utilities
+};
+
+struct FlatNode {
+    uint16_t type;
+    uint16_t leaf;   // action or condition index for leaves, scorer index for FLAT_UTILITY
+    uint32_t skip;   // index of the first node after this subtree
+};
+
+class FlatBehaviorTree {
+public:
+    std::vector<FlatNode> nodes;
+    std::vector<std::string> actionNames;
+    std::vector<std::string> conditionNames;
+    std::vector<bool> conditionValues;   // the value each ConditionNode was built with
+    std::vector<BlackboardKey<bool>> conditionKeys;   // key each condition reads, or NO_BLACKBOARD_KEY
+    std::vector<UtilityScorer> utilities;
+    std::vector<std::string> compositeNames;   // per node, empty for leaves
+    int depth = 0;                       // deepest nesting of composites
+
+    static const int MAX_DEPTH = 64;
+
+    static constexpr uint32_t NO_LEAF = 0xFFFFFFFFu;
+
+    // Ticks the tree once. Leaves call handler.runAction(index) and
+    // handler.checkCondition(index), which inline since the handler type is known;
+    // they return bool or NodeStatus. Utility selectors call handler.chooseChild(index).
+    // Each composite the tick enters, or resumes through, is passed to
+    // handler.enterComposite(node) first. A leaf returning Running ends the tick and is
+    // stored in runningLeaf; the next tick resumes at that leaf with its ancestors open.
+    template <class Handler>
+    NodeStatus tick(Handler& handler, uint32_t& runningLeaf) const {
+        uint32_t open[MAX_DEPTH];
+        int top = 0;
+        uint32_t i = 0;
+
+        if (runningLeaf != NO_LEAF) {
+            uint32_t target = runningLeaf;
+            while (i != target) {
+                handler.enterComposite(i);
+                open[top++] = i++;
+                while (nodes[i].skip <= target)
+                    i = nodes[i].skip;
+            }
+            runningLeaf = NO_LEAF;
+        }
+
+        while (true) {
+            const FlatNode& node = nodes[i];
+            NodeStatus result;
+            if (node.type != FLAT_ACTION && node.type != FLAT_CONDITION) {
+                handler.enterComposite(i);
+                uint32_t child = i + 1;
+                if (node.type == FLAT_UTILITY && child < node.skip) {
+                    for (int choice = handler.chooseChild(node.leaf); choice > 0 && child < node.skip; --choice)
+                        child = nodes[child].skip;
+                }
+                if (child < node.skip) {
+                    open[top++] = i;
+                    i = child;
+                    continue;
+                }
+                // an empty sequence succeeds; an empty selector or utility selector fails
+                result = node.type == FLAT_SEQUENCE ? NODE_SUCCESS : NODE_FAILURE;
+            } else if (node.type == FLAT_ACTION) {
+                result = leafStatus(handler.runAction(node.leaf));
+            } else {
+                result = leafStatus(handler.checkCondition(node.leaf));
+            }
+
+            if (result == NODE_RUNNING) {
+                runningLeaf = i;
+                return NODE_RUNNING;
+            }
+
+            // Hand the result up until a composite still has children to run
+            uint32_t next = node.skip;
+            while (true) {
+                if (top == 0)
+                    return result;
+                const FlatNode& parent = nodes[open[top - 1]];
+                bool decided = parent.type == FLAT_SEQUENCE ? result == NODE_FAILURE
+                    : parent.type == FLAT_SELECTOR ? result == NODE_SUCCESS : true;
+                if (!decided && next < parent.skip)
+                    break;
+                next = parent.skip;
+                --top;
+            }
+            i = next;
+        }
+    }
+
+    // One-shot tick for trees whose leaves never return Running
+    template <class Handler>
+    NodeStatus tick(Handler& handler) const {
+        uint32_t runningLeaf = NO_LEAF;
+        return tick(handler, runningLeaf);
+    }
+
+private:
+    static NodeStatus leafStatus(bool ok) {
+        return ok ? NODE_SUCCESS : NODE_FAILURE;
+    }
+
+    static NodeStatus leafStatus(NodeStatus status) {
+        return status;
+    }
+};
+
+// Builds a FlatBehaviorTree from a BehaviorNode graph (see compile() on each node type)
+class BehaviorTreeCompiler {
+public:
+    FlatBehaviorTree compile(const BehaviorNode& root) {
+        tree = FlatBehaviorTree();
+        openDepth = 0;
+        root.compile(*this);
+        if (tree.depth > FlatBehaviorTree::MAX_DEPTH) {
+            std::cerr << "Behavior tree nests deeper than " << FlatBehaviorTree::MAX_DEPTH << " composites" << std::endl;
+            tree = FlatBehaviorTree();
+            tree.nodes.push_back({FLAT_SELECTOR, 0, 1});
+            tree.compositeNames.push_back("");
+        }
+        return tree;
+    }
+
+    void addAction(const std::string& name) {
+        tree.nodes.push_back({FLAT_ACTION, (uint16_t)tree.actionNames.size(), (uint32_t)tree.nodes.size() + 1});
+        tree.compositeNames.push_back("");
+        tree.actionNames.push_back(name);
+    }
+
+    void addCondition(const std::string& name, bool value, BlackboardKey<bool> key) {
+        tree.nodes.push_back({FLAT_CONDITION, (uint16_t)tree.conditionNames.size(), (uint32_t)tree.nodes.size() + 1});
+        tree.compositeNames.push_back("");
+        tree.conditionNames.push_back(name);
+        tree.conditionValues.push_back(value);
+        tree.conditionKeys.push_back(key);
+    }
+
+    // Composites: begin, compile the children, then end to patch the skip offset
+    size_t beginComposite(FlatNodeType type, const std::string& name) {
+        tree.nodes.push_back({type, 0, 0});
+        tree.compositeNames.push_back(name);
+        tree.depth = std::max(tree.depth, ++openDepth);
+        return tree.nodes.size() - 1;
+    }
+
+    size_t beginUtility(const UtilityScorer& scorer, const std::string& name) {
+        size_t index = beginComposite(FLAT_UTILITY, name);
+        tree.nodes[index].leaf = tree.utilities.size();
+        tree.utilities.push_back(scorer);
+        return index;
+    }
+
+    void endComposite(size_t index) {
+        tree.nodes[index].skip = tree.nodes.size();
+        --openDepth;
+    }
+
+private:
+    FlatBehaviorTree tree;
+    int openDepth = 0;
+};
+
+void ActionNode::compile(BehaviorTreeCompiler& compiler) const {
+    compiler.addAction(actionName);
+}
+
+void ConditionNode::compile(BehaviorTreeCompiler& compiler) const {
+    compiler.addCondition(conditionName, condition, key);
+}
+
+void SequenceNode::compile(BehaviorTreeCompiler& compiler) const {
+    size_t index = compiler.beginComposite(FLAT_SEQUENCE, sequenceName);
+    for (BehaviorNode* child : children) {
+        child->compile(compiler);
+    }
+    compiler.endComposite(index);
+}
+
+void SelectorNode::compile(BehaviorTreeCompiler& compiler) const {
+    size_t index = compiler.beginComposite(FLAT_SELECTOR, selectorName);
+    for (BehaviorNode* child : children) {
+        child->compile(compiler);
+    }
+    compiler.endComposite(index);
+}
+
+void UtilitySelectorNode::compile(BehaviorTreeCompiler& compiler) const {
+    size_t index = compiler.beginUtility(scorer, selectorName);
+    for (BehaviorNode* child : children) {
+        child->compile(compiler);
+    }
+    compiler.endComposite(index);
+}
+
+// Leaf handler that behaves like the node classes: composites log as they are entered,
+// actions log and succeed, conditions log and return the value they were built with or
+// read from the blackboard
+struct LoggingLeafHandler {
+    const FlatBehaviorTree& tree;
+    const Blackboard* blackboard;
+
+    void enterComposite(uint32_t node) {
+        const char* kind = tree.nodes[node].type == FLAT_SEQUENCE ? "Sequence"
+            : tree.nodes[node].type == FLAT_SELECTOR ? "Selector" : "Utility Selector";
+        std::cout << "Executing " << kind << ": " << tree.compositeNames[node] << std::endl;
+    }
+
+    bool runAction(int index) {
+        std::cout << "Executing Action: " << tree.actionNames[index] << std::endl;
+        return true;
+    }
+
+    bool checkCondition(int index) {
+        std::cout << "Checking Condition: " << tree.conditionNames[index] << std::endl;
+        if (blackboard && tree.conditionKeys[index].bit != NO_BLACKBOARD_KEY.bit)
+            return blackboard->get(tree.conditionKeys[index]);
+        return tree.conditionValues[index];
+    }
+
+    int chooseChild(int index) {
+        Blackboard empty = {};
+        return tree.utilities[index].choose(blackboard ? *blackboard : empty);
+    }
+};
+
+// Ticks one compiled tree for many agents at once. Control flow in a flat tree only
+// moves forward, and where a leaf's result leads (the next leaf, or the end of the tick)
+// depends only on the leaf and the result, so both are tabulated up front; so is where
+// each choice of a utility selector leads. A tick then sweeps those stops in order:
+// every agent waiting at one is evaluated in one handler call over that agent range and
+// moved to the bucket of the stop it goes to next.
+//
+// Per-agent state (status, and the leaf a Running agent resumes at) lives in flat arrays.
+// Agents are split into contiguous slices, one per worker thread; the handler is called
+// from several threads, for disjoint agents, and writes a NodeStatus per agent:
+//   void runActions(int action, const uint32_t* agents, int count, uint8_t* results);
+//   void checkConditions(int condition, const uint32_t* agents, int count, uint8_t* results);
+//   void chooseChildren(int utility, const uint32_t* agents, int count, uint8_t* choices);
+template <class Handler>
+class BatchTreeRunner {
+public:
+    static constexpr uint32_t DONE_SUCCESS = 0xFFFFFFFEu;
+    static constexpr uint32_t DONE_FAILURE = 0xFFFFFFFFu;
+
+    BatchTreeRunner(const FlatBehaviorTree& tree, int agentCount, int threadCount)
+        : tree(tree), agentCount(agentCount), status(agentCount, NODE_FAILURE), lastLeaf(agentCount, 0),
+          resumeLeaf(agentCount, FlatBehaviorTree::NO_LEAF),
+          handler(nullptr), generation(0), pendingSlices(0), stopping(false) {
+        buildTransitions();
+
+        threadCount = std::max(1, threadCount);
+        for (int t = 0; t < threadCount; ++t) {
+            Slice slice;
+            slice.first = (long long)agentCount * t / threadCount;
+            slice.last = (long long)agentCount * (t + 1) / threadCount;
+            slice.buckets.resize(tree.nodes.size());
+            slices.push_back(slice);
+        }
+        for (int t = 1; t < threadCount; ++t)
+            workers.emplace_back(&BatchTreeRunner::workerLoop, this, t);
+    }
+
+    ~BatchTreeRunner() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+    }
+
+    BatchTreeRunner(const BatchTreeRunner&) = delete;
+    BatchTreeRunner& operator=(const BatchTreeRunner&) = delete;
+
+    // Ticks every agent once; slice 0 runs on the calling thread
+    void tick(Handler& h) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            handler = &h;
+            pendingSlices = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        tickSlice(slices[0], h);
+
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [this] { return pendingSlices == 0; });
+    }
+
+    // NodeStatus of each agent's last tick
+    const std::vector<uint8_t>& statuses() const {
+        return status;
+    }
+
+    // Leaf each agent's last tick ended on
+    const std::vector<uint32_t>& finalLeaves() const {
+        return lastLeaf;
+    }
+
+private:
+    struct Slice {
+        uint32_t first;
+        uint32_t last;
+        std::vector<std::vector<uint32_t>> buckets;   // agents waiting at each leaf
+        std::vector<uint8_t> leafResults;
+    };
+
+    const FlatBehaviorTree& tree;
+    uint32_t agentCount;
+    uint32_t entry;                     // first stop reached from the root, or DONE_*
+    std::vector<uint32_t> onSuccess;    // per leaf: where a success leads
+    std::vector<uint32_t> onFailure;    // also where a utility selector's out-of-range choice leads
+    std::vector<std::vector<uint32_t>> onChoice;   // per utility selector: where each child leads
+    std::vector<uint8_t> status;
+    std::vector<uint32_t> lastLeaf;
+    std::vector<uint32_t> resumeLeaf;   // leaf that returned Running, or NO_LEAF
+    std::vector<Slice> slices;
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+    Handler* handler;
+    unsigned long long generation;
+    size_t pendingSlices;
+    bool stopping;
+
+    bool isComposite(uint32_t i) const {
+        return tree.nodes[i].type != FLAT_ACTION && tree.nodes[i].type != FLAT_CONDITION;
+    }
+
+    // Stop reached by entering node i: a leaf or a utility selector with children
+    // (an empty composite resolves straight away)
+    uint32_t enter(uint32_t i, const std::vector<int>& parent) const {
+        while (isComposite(i)) {
+            if (tree.nodes[i].skip == i + 1)
+                return resolve(i, tree.nodes[i].type == FLAT_SEQUENCE, parent);
+            if (tree.nodes[i].type == FLAT_UTILITY)
+                return i;
+            ++i;
+        }
+        return i;
+    }
+
+    // Where node i finishing with `result` leads: a later leaf, or the end of the tick
+    uint32_t resolve(uint32_t i, bool result, const std::vector<int>& parent) const {
+        while (true) {
+            int p = parent[i];
+            if (p < 0)
+                return result ? DONE_SUCCESS : DONE_FAILURE;
+            bool decided = tree.nodes[p].type == FLAT_SEQUENCE ? !result
+                : tree.nodes[p].type == FLAT_SELECTOR ? result : true;
+            if (!decided && tree.nodes[i].skip < tree.nodes[p].skip)
+                return enter(tree.nodes[i].skip, parent);
+            i = p;
+        }
+    }
+
+    void buildTransitions() {
+        size_t n = tree.nodes.size();
+        std::vector<int> parent(n, -1);
+        std::vector<uint32_t> open;
+        for (uint32_t i = 0; i < n; ++i) {
+            while (!open.empty() && tree.nodes[open.back()].skip <= i)
+                open.pop_back();
+            if (!open.empty())
+                parent[i] = open.back();
+            if (isComposite(i))
+                open.push_back(i);
+        }
+
+        onSuccess.assign(n, DONE_SUCCESS);
+        onFailure.assign(n, DONE_FAILURE);
+        onChoice.assign(n, std::vector<uint32_t>());
+        for (uint32_t i = 0; i < n; ++i) {
+            if (!isComposite(i)) {
+                onSuccess[i] = resolve(i, true, parent);
+                onFailure[i] = resolve(i, false, parent);
+            } else if (tree.nodes[i].type == FLAT_UTILITY) {
+                onFailure[i] = resolve(i, false, parent);
+                for (uint32_t child = i + 1; child < tree.nodes[i].skip; child = tree.nodes[child].skip)
+                    onChoice[i].push_back(enter(child, parent));
+            }
+        }
+        entry = n == 0 ? DONE_FAILURE : enter(0, parent);
+    }
+
+    void finish(uint32_t agent, uint32_t leaf, uint32_t destination) {
+        status[agent] = destination == DONE_SUCCESS ? NODE_SUCCESS : NODE_FAILURE;
+        lastLeaf[agent] = leaf;
+    }
+
+    void tickSlice(Slice& slice, Handler& h) {
+        // Running agents resume at their leaf, the rest start at the entry leaf
+        uint32_t firstLeaf = entry;
+        for (uint32_t a = slice.first; a < slice.last; ++a) {
+            uint32_t start = resumeLeaf[a];
+            resumeLeaf[a] = FlatBehaviorTree::NO_LEAF;
+            if (start == FlatBehaviorTree::NO_LEAF)
+                start = entry;
+            if (start >= DONE_SUCCESS) {
+                finish(a, 0, start);
+                continue;
+            }
+            slice.buckets[start].push_back(a);
+            firstLeaf = std::min(firstLeaf, start);
+        }
+
+        for (uint32_t leaf = firstLeaf; leaf < tree.nodes.size(); ++leaf) {
+            std::vector<uint32_t>& agents = slice.buckets[leaf];
+            if (agents.empty())
+                continue;
+
+            int count = agents.size();
+            slice.leafResults.resize(count);
+            const FlatNode& node = tree.nodes[leaf];
+            if (node.type == FLAT_UTILITY) {
+                h.chooseChildren(node.leaf, agents.data(), count, slice.leafResults.data());
+                const std::vector<uint32_t>& targets = onChoice[leaf];
+                for (int k = 0; k < count; ++k) {
+                    uint8_t choice = slice.leafResults[k];
+                    uint32_t next = choice < targets.size() ? targets[choice] : onFailure[leaf];
+                    if (next >= DONE_SUCCESS)
+                        finish(agents[k], leaf, next);
+                    else
+                        slice.buckets[next].push_back(agents[k]);
+                }
+                agents.clear();
+                continue;
+            }
+
+            if (node.type == FLAT_ACTION)
+                h.runActions(node.leaf, agents.data(), count, slice.leafResults.data());
+            else
+                h.checkConditions(node.leaf, agents.data(), count, slice.leafResults.data());
+
+            for (int k = 0; k < count; ++k) {
+                if (slice.leafResults[k] == NODE_RUNNING) {
+                    status[agents[k]] = NODE_RUNNING;
+                    lastLeaf[agents[k]] = leaf;
+                    resumeLeaf[agents[k]] = leaf;
+                    continue;
+                }
+                uint32_t next = slice.leafResults[k] == NODE_SUCCESS ? onSuccess[leaf] : onFailure[leaf];
+                if (next >= DONE_SUCCESS)
+                    finish(agents[k], leaf, next);
+                else
+                    slice.buckets[next].push_back(agents[k]);
+            }
+            agents.clear();
+        }
+    }
+
+    void workerLoop(int index) {
+        unsigned long long seen = 0;
+        while (true) {
+            Handler* h;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                h = handler;
+            }
+
+            tickSlice(slices[index], *h);
+
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--pendingSlices == 0)
+                done.notify_one();
+        }
+    }
+};
+
+// Blackboard layout shared by the example agents; distances, health and ammo are 0-100
+constexpr BlackboardKey<bool> ENEMY_VISIBLE = firstKey<bool>();
+constexpr BlackboardKey<float> ENEMY_DISTANCE = keyAfter<float>(ENEMY_VISIBLE);
+constexpr BlackboardKey<float> HEALTH = keyAfter<float>(ENEMY_DISTANCE);
+constexpr BlackboardKey<float> AMMO = keyAfter<float>(HEALTH);
+static_assert(AMMO.end() <= Blackboard::CAPACITY, "example keys do not fit the blackboard");
+
+// Example agents for the guard tree below: one blackboard per agent, in an array,
+// and the last action each agent ran
+struct GuardAgents {
+    const FlatBehaviorTree& tree;
+    std::vector<Blackboard> blackboards;
+    std::vector<uint16_t> lastAction;
+
+    GuardAgents(const FlatBehaviorTree& tree, int count) : tree(tree), blackboards(count), lastAction(count, 0) {}
+
+    void runActions(int action, const uint32_t* agents, int count, uint8_t* results) {
+        for (int k = 0; k < count; ++k) {
+            lastAction[agents[k]] = action;
+            results[k] = NODE_SUCCESS;
+        }
+    }
+
+    void checkConditions(int condition, const uint32_t* agents, int count, uint8_t* results) {
+        BlackboardKey<bool> key = tree.conditionKeys[condition];
+        for (int k = 0; k < count; ++k)
+            results[k] = blackboards[agents[k]].get(key) ? NODE_SUCCESS : NODE_FAILURE;
+    }
+
+    void chooseChildren(int utility, const uint32_t* agents, int count, uint8_t* choices) {
+        tree.utilities[utility].chooseBatch(blackboards.data(), agents, count, choices);
+    }
 };
 
 int main() {
@@ -114,8 +1195,118 @@ int main() {
     std::cout << "=== Behavior Tree Execution ===" << std::endl;
     rootSelector->execute();
 
+    // Execute the compiled form of the same tree
+    BehaviorTreeCompiler compiler;
+    FlatBehaviorTree flatTree = compiler.compile(*rootSelector);
+    LoggingLeafHandler handler = {flatTree, nullptr};
+    std::cout << "=== Compiled Behavior Tree (" << flatTree.nodes.size() << " nodes) ===" << std::endl;
+    NodeStatus result = flatTree.tick(handler);
+    std::cout << "Result: " << (result == NODE_SUCCESS ? "success" : "failure") << std::endl;
+
+    // Event-driven agent: attacking takes three ticks, and the tree only wakes up
+    // again when the value its condition reads changes
+    Blackboard blackboard = {};
+    SelectorNode* sentry = new SelectorNode("Sentry Selector");
+    SequenceNode* fight = new SequenceNode("Fight Sequence");
+    fight->addChild(new ConditionNode("Is Enemy Visible?", ENEMY_VISIBLE, &blackboard));
+    fight->addChild(new ActionNode("Attack Enemy", 3));
+    sentry->addChild(fight);
+    sentry->addChild(new ActionNode("Idle"));
+
+    std::cout << "=== Event-Driven Behavior Tree ===" << std::endl;
+    EventDrivenTree sentryTree(*sentry, blackboard);
+    int evaluations = 0;
+    for (int frame = 0; frame < 10; ++frame) {
+        blackboard.set(ENEMY_DISTANCE, 50.0f - frame);   // not read by the tree, so it never wakes it
+        if (frame == 2) {
+            blackboard.set(ENEMY_VISIBLE, true);
+        }
+        if (frame == 7) {
+            blackboard.set(ENEMY_VISIBLE, false);
+        }
+        if (sentryTree.tick()) {
+            ++evaluations;
+        }
+    }
+    std::cout << "Ticked 10 frames, tree evaluated on " << evaluations << std::endl;
+
+    // Tick a guard tree for a crowd of agents at once; in a fight each guard weighs
+    // its options by distance, health and ammo
+    const ResponseCurve closer = {CURVE_POLYNOMIAL, 1, -1.0f, 0.0f, 1.0f};       // 1 - x
+    const ResponseCurve plenty = {CURVE_POLYNOMIAL, 1, 1.0f, 0.0f, 0.0f};        // x
+    const ResponseCurve running = {CURVE_POLYNOMIAL, 2, 1.0f, 1.0f, 0.0f};       // (1 - x)^2
+    const ResponseCurve nearlyDead = {CURVE_LOGISTIC, 0, -12.0f, 0.3f, 0.0f};    // drops past 30%
+
+    UtilitySelectorNode* combat = new UtilitySelectorNode("Combat Choice");
+    combat->addChild(new ActionNode("Attack Enemy"), {"Attack Enemy", 1.0f,
+        {{ENEMY_DISTANCE, 0.0f, 100.0f, closer}, {AMMO, 0.0f, 100.0f, plenty}, {HEALTH, 0.0f, 100.0f, plenty}}});
+    combat->addChild(new ActionNode("Reload"), {"Reload", 0.9f, {{AMMO, 0.0f, 100.0f, running}}});
+    combat->addChild(new ActionNode("Flee"), {"Flee", 1.0f, {{HEALTH, 0.0f, 100.0f, nearlyDead}}});
+    combat->addChild(new ActionNode("Take Cover"), {"Take Cover", 0.3f, {{ENEMY_DISTANCE, 0.0f, 100.0f, plenty}}});
+
+    SelectorNode* guard = new SelectorNode("Guard Selector");
+    SequenceNode* engage = new SequenceNode("Engage Sequence");
+    engage->addChild(new ConditionNode("Is Enemy Visible?", ENEMY_VISIBLE));
+    engage->addChild(combat);
+    guard->addChild(engage);
+    guard->addChild(new ActionNode("Patrol"));
+
+    const int agentCount = 100000;
+    FlatBehaviorTree guardTree = compiler.compile(*guard);
+    GuardAgents crowd(guardTree, agentCount);
+    for (int a = 0; a < agentCount; ++a) {
+        crowd.blackboards[a].set(ENEMY_VISIBLE, std::rand() % 4 == 0);
+        crowd.blackboards[a].set(ENEMY_DISTANCE, (float)(std::rand() % 100));
+        crowd.blackboards[a].set(HEALTH, (float)(std::rand() % 100));
+        crowd.blackboards[a].set(AMMO, (float)(std::rand() % 100));
+    }
+
+    BatchTreeRunner<GuardAgents> runner(guardTree, agentCount, std::max(1u, std::thread::hardware_concurrency()));
+    auto begin = std::chrono::steady_clock::now();
+    runner.tick(crowd);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    std::vector<int> actionTotals(guardTree.actionNames.size(), 0);
+    for (int a = 0; a < agentCount; ++a) {
+        ++actionTotals[crowd.lastAction[a]];
+    }
+    std::cout << "Ticked " << agentCount << " agents in " << ms << " ms:";
+    for (size_t i = 0; i < actionTotals.size(); ++i) {
+        std::cout << " " << guardTree.actionNames[i] << " " << actionTotals[i] << (i + 1 < actionTotals.size() ? "," : "");
+    }
+    std::cout << std::endl;
+
+    // Score a wide utility set: 24 actions over three inputs for 10k agents
+    UtilityScorer wide;
+    for (int i = 0; i < 24; ++i) {
+        BlackboardKey<float> inputs[3] = {ENEMY_DISTANCE, HEALTH, AMMO};
+        ResponseCurve first = {i % 2 ? CURVE_LOGISTIC : CURVE_POLYNOMIAL, 1 + i % 3, (i % 2 ? 8.0f : 1.0f), (i % 5) * 0.2f, 0.1f};
+        ResponseCurve second = {CURVE_POLYNOMIAL, 1 + i % 2, -1.0f, 1.0f - (i % 4) * 0.1f, 1.0f};
+        wide.addAction({"Option " + std::to_string(i), 0.5f + (i % 7) * 0.1f,
+            {{inputs[i % 3], 0.0f, 100.0f, first}, {inputs[(i + 1) % 3], 0.0f, 100.0f, second}}});
+    }
+    const int scoredAgents = 10000;
+    std::vector<uint32_t> scoredIds(scoredAgents);
+    std::vector<uint8_t> choices(scoredAgents);
+    for (int a = 0; a < scoredAgents; ++a) {
+        scoredIds[a] = a;
+    }
+    begin = std::chrono::steady_clock::now();
+    wide.chooseBatch(crowd.blackboards.data(), scoredIds.data(), scoredAgents, choices.data());
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "Scored " << wide.actionCount() << " actions for " << scoredAgents << " agents in " << ms << " ms ("
+              << LANE_COUNT << " lanes)" << std::endl;
+
     // Cleanup
     delete rootSelector;  // This will recursively delete all nodes
+    delete guard;
+    delete sentry;
+
+    ActionNode::pool().report(std::cout, "ActionNode");
+    ConditionNode::pool().report(std::cout, "ConditionNode");
+    SequenceNode::pool().report(std::cout, "SequenceNode");
+    SelectorNode::pool().report(std::cout, "SelectorNode");
+    MemoryTracker::instance().dump(std::cout);
 
     return 0;
 }
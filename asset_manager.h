@@ -0,0 +1,550 @@
+#ifndef ASSET_MANAGER_H
+#define ASSET_MANAGER_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_mixer.h>
+#include <SDL2/SDL_ttf.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "asset_pack.h"
+#include "memory_tracker.h"
+
+// Background asset loading. load() returns a handle at once and queues the asset for a pool
+// of worker threads, which read the file and decode it off the main thread: images into
+// surfaces, music into Mix_Music, levels into tile rows. Work SDL only allows on the render
+// thread (creating textures, opening fonts, which share FreeType state with text rendering)
+// is queued back and done by update(), which the game calls once per frame under a time
+// budget. Both queues are served in priority order, so a title-screen font requested as
+// ASSET_PRIORITY_HIGH is usable while the level behind it is still streaming.
+//
+// With a pack set, assets are looked up in it first and stored entries are handed to SDL
+// straight from the mapping through SDL_RWops, without a copy; anything the pack does not
+// contain is read from a loose file. Assets are shared by path: loading a path that is
+// already loaded returns the same asset.
+// Handles are reference counted and an asset is freed by the first update() after its last
+// handle is gone. Handles must be created, copied and dropped on the main thread.
+//
+// reload() decodes a changed file again in the background. The asset keeps its old contents
+// until the new ones are ready; then update() swaps them in, frees the old objects and bumps
+// the asset's version, which callers that keep raw pointers (a playing Mix_Music) compare to
+// notice the change.
+
+enum AssetType : uint8_t { ASSET_TEXTURE, ASSET_MUSIC, ASSET_FONT, ASSET_LEVEL };
+
+enum AssetPriority : uint8_t { ASSET_PRIORITY_HIGH, ASSET_PRIORITY_NORMAL, ASSET_PRIORITY_LOW };
+
+enum AssetState : uint8_t {
+    ASSET_QUEUED,     // waiting for a worker
+    ASSET_DECODED,    // waiting for update() to finish it on the main thread
+    ASSET_READY,
+    ASSET_FAILED
+};
+
+typedef std::vector<int, TrackedAllocator<int, MEM_LEVEL>> LevelRow;
+typedef std::vector<LevelRow, TrackedAllocator<LevelRow, MEM_LEVEL>> LevelRows;
+
+// One row per line of whitespace-separated tile numbers, as written by the level editor
+inline void parseLevelRows(const std::string& text, LevelRows& rows) {
+    rows.clear();
+    std::istringstream in(text);
+    std::string line;
+    std::vector<int> scratch;   // reused per line, so each row is stored at its exact size
+    while (std::getline(in, line, '\n')) {
+        scratch.clear();
+        std::istringstream ss(line);
+        int tileType;
+        while (ss >> tileType)
+            scratch.push_back(tileType);
+        rows.emplace_back(scratch.begin(), scratch.end());
+    }
+}
+
+struct Asset {
+    std::string path;
+    AssetType type;
+    AssetPriority priority;
+    int fontSize;
+    std::atomic<AssetState> state;
+    int refs;                          // main thread only
+    uint32_t version;                  // completed reloads; main thread only
+    int pendingReloads;
+
+    // Filled in by the worker, consumed by update()
+    std::vector<unsigned char> bytes;  // loose file or unpacked entry, when not mapped
+    const unsigned char* data;         // contents: bytes, or an entry in the pack's mapping
+    size_t size;                       // fonts and music keep reading these while in use
+    SDL_Surface* surface;
+
+    SDL_Texture* texture;
+    Mix_Music* music;
+    TTF_Font* font;
+    LevelRows level;
+
+    Asset(const std::string& path, AssetType type, AssetPriority priority, int fontSize)
+        : path(path), type(type), priority(priority), fontSize(fontSize), state(ASSET_QUEUED), refs(0), version(0), pendingReloads(0),
+          data(nullptr), size(0), surface(nullptr), texture(nullptr), music(nullptr), font(nullptr) {}
+};
+
+class AssetHandle {
+public:
+    AssetHandle() : asset(nullptr) {}
+
+    AssetHandle(const AssetHandle& other) : asset(other.asset) {
+        if (asset)
+            ++asset->refs;
+    }
+
+    AssetHandle(AssetHandle&& other) : asset(other.asset) {
+        other.asset = nullptr;
+    }
+
+    AssetHandle& operator=(AssetHandle other) {
+        std::swap(asset, other.asset);
+        return *this;
+    }
+
+    ~AssetHandle() {
+        if (asset)
+            --asset->refs;
+    }
+
+    bool ready() const {
+        return asset && asset->state.load(std::memory_order_acquire) == ASSET_READY;
+    }
+
+    bool failed() const {
+        return !asset || asset->state.load(std::memory_order_acquire) == ASSET_FAILED;
+    }
+
+    // The loaded object, or null until the asset is ready
+    SDL_Texture* texture() const {
+        return ready() ? asset->texture : nullptr;
+    }
+
+    Mix_Music* music() const {
+        return ready() ? asset->music : nullptr;
+    }
+
+    TTF_Font* font() const {
+        return ready() ? asset->font : nullptr;
+    }
+
+    const LevelRows* level() const {
+        return ready() ? &asset->level : nullptr;
+    }
+
+    uint32_t version() const {
+        return asset ? asset->version : 0;
+    }
+
+private:
+    friend class AssetManager;
+    Asset* asset;
+
+    explicit AssetHandle(Asset* asset) : asset(asset) {
+        ++asset->refs;
+    }
+};
+
+class AssetManager {
+public:
+    // Starts the workers; 0 picks one less than the number of cores
+    explicit AssetManager(int workerCount = 0) : renderer(nullptr), pack(nullptr), sequence(0), stopping(false) {
+        if (workerCount <= 0)
+            workerCount = std::max(1, std::min(4, (int)std::thread::hardware_concurrency() - 1));
+        for (int i = 0; i < workerCount; ++i)
+            workers.emplace_back(&AssetManager::workerLoop, this);
+    }
+
+    ~AssetManager() {
+        shutdown();
+    }
+
+    AssetManager(const AssetManager&) = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
+
+    // Looks assets up in this pack before the file system; it must stay open as long as the
+    // manager. Set it before loading any.
+    void setPack(const AssetPack* source) {
+        pack = source;
+    }
+
+    // Textures are created for this renderer; set it before loading any
+    void setRenderer(SDL_Renderer* target) {
+        renderer = target;
+    }
+
+    AssetHandle load(const std::string& path, AssetType type, AssetPriority priority = ASSET_PRIORITY_NORMAL, int fontSize = 0) {
+        std::string key = path + '#' + std::to_string(fontSize);
+        auto found = assets.find(key);
+        if (found != assets.end())
+            return AssetHandle(found->second.get());
+
+        Asset* asset = new Asset(path, type, priority, fontSize);
+        assets.emplace(key, std::unique_ptr<Asset>(asset));
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            decodeQueue.push({priority, sequence++, asset});
+        }
+        wake.notify_one();
+        return AssetHandle(asset);
+    }
+
+    // Queues every loaded asset with this path to be decoded again; returns how many. Assets
+    // still on their first load are skipped, as they may already read the new file.
+    int reload(const std::string& path) {
+        int queued = 0;
+        for (auto& entry : assets) {
+            Asset* target = entry.second.get();
+            AssetState state = target->state.load(std::memory_order_acquire);
+            if (target->path != path || (state != ASSET_READY && state != ASSET_FAILED))
+                continue;
+
+            for (Reload& pending : reloads) {
+                if (pending.target == target)
+                    pending.superseded = true;   // only the newest contents are applied
+            }
+            Asset* replacement = new Asset(path, target->type, target->priority, target->fontSize);
+            reloads.push_back({target, std::unique_ptr<Asset>(replacement), false});
+            ++target->pendingReloads;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                decodeQueue.push({target->priority, sequence++, replacement});
+            }
+            ++queued;
+        }
+        if (queued > 0)
+            wake.notify_all();
+        return queued;
+    }
+
+    // Main thread, once per frame: finishes decoded assets until the time budget is spent (at
+    // least one per call), applies finished reloads, and frees assets that no handle refers
+    // to any more
+    void update(double budgetMicros) {
+        auto start = std::chrono::steady_clock::now();
+        int finished = 0;
+        while (true) {
+            if (finished > 0 && std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() > budgetMicros)
+                break;
+            Asset* asset;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (finishQueue.empty())
+                    break;
+                asset = finishQueue.top().asset;
+                finishQueue.pop();
+            }
+            finish(asset);
+            ++finished;
+        }
+
+        for (size_t i = 0; i < reloads.size();) {
+            Reload& pending = reloads[i];
+            AssetState state = pending.replacement->state.load(std::memory_order_acquire);
+            if (state != ASSET_READY && state != ASSET_FAILED) {
+                ++i;
+                continue;
+            }
+            if (state == ASSET_READY && !pending.superseded) {
+                swapContents(*pending.target, *pending.replacement);
+                pending.target->state.store(ASSET_READY, std::memory_order_release);
+                ++pending.target->version;
+            }
+            release(pending.replacement.get());   // the old contents, after a swap
+            --pending.target->pendingReloads;
+            reloads.erase(reloads.begin() + i);
+        }
+
+        for (auto it = assets.begin(); it != assets.end();) {
+            Asset* asset = it->second.get();
+            AssetState state = asset->state.load(std::memory_order_acquire);
+            if (asset->refs == 0 && asset->pendingReloads == 0 && (state == ASSET_READY || state == ASSET_FAILED)) {
+                release(asset);
+                it = assets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Blocks until the asset is ready or has failed; for loads nothing can be shown without
+    bool wait(const AssetHandle& handle) {
+        if (!handle.asset)
+            return false;
+        while (true) {
+            AssetState state = handle.asset->state.load(std::memory_order_acquire);
+            if (state == ASSET_READY)
+                return true;
+            if (state == ASSET_FAILED)
+                return false;
+            if (state == ASSET_DECODED) {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    removeFromFinishQueue(handle.asset);
+                }
+                finish(handle.asset);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mtx);
+            decoded.wait(lock, [&] { return handle.asset->state.load() != ASSET_QUEUED; });
+        }
+    }
+
+    // Stops the workers and frees every asset's SDL objects; call before closing the renderer,
+    // mixer and TTF. Handles still held afterwards report failed().
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (stopping && workers.empty())
+                return;
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+        decodeQueue = std::priority_queue<Pending>();
+        finishQueue = std::priority_queue<Pending>();
+        for (Reload& pending : reloads) {
+            release(pending.replacement.get());
+            --pending.target->pendingReloads;
+        }
+        reloads.clear();
+
+        for (auto it = assets.begin(); it != assets.end();) {
+            Asset* asset = it->second.get();
+            release(asset);
+            asset->state.store(ASSET_FAILED, std::memory_order_release);
+            if (asset->refs == 0)
+                it = assets.erase(it);
+            else
+                ++it;
+        }
+    }
+
+private:
+    struct Pending {
+        AssetPriority priority;
+        uint64_t sequence;
+        Asset* asset;
+
+        // priority_queue pops the largest: highest priority, then oldest request
+        bool operator<(const Pending& other) const {
+            if (priority != other.priority)
+                return priority > other.priority;
+            return sequence > other.sequence;
+        }
+    };
+
+    SDL_Renderer* renderer;
+    const AssetPack* pack;
+    struct Reload {
+        Asset* target;
+        std::unique_ptr<Asset> replacement;   // decoded like a new asset, then swapped in
+        bool superseded;
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<Asset>> assets;   // main thread only
+    std::vector<Reload> reloads;                                       // main thread only
+    std::mutex mtx;
+    std::condition_variable wake;      // work for the decoders
+    std::condition_variable decoded;   // an asset left the decode queue
+    std::priority_queue<Pending> decodeQueue;
+    std::priority_queue<Pending> finishQueue;
+    uint64_t sequence;
+    bool stopping;
+    std::vector<std::thread> workers;
+
+    void workerLoop() {
+        while (true) {
+            Asset* asset;
+            uint64_t order;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this] { return stopping || !decodeQueue.empty(); });
+                if (stopping)
+                    return;
+                asset = decodeQueue.top().asset;
+                order = decodeQueue.top().sequence;
+                decodeQueue.pop();
+            }
+
+            bool ok = decode(asset);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (ok && needsMainThread(asset->type))
+                    finishQueue.push({asset->priority, order, asset});
+                asset->state.store(!ok ? ASSET_FAILED : (needsMainThread(asset->type) ? ASSET_DECODED : ASSET_READY),
+                                   std::memory_order_release);
+            }
+            decoded.notify_all();
+        }
+    }
+
+    static bool needsMainThread(AssetType type) {
+        return type == ASSET_TEXTURE || type == ASSET_FONT;
+    }
+
+    static MemoryTag tagFor(AssetType type) {
+        switch (type) {
+            case ASSET_TEXTURE:
+                return MEM_TEXTURES;
+            case ASSET_MUSIC:
+                return MEM_AUDIO;
+            case ASSET_LEVEL:
+                return MEM_LEVEL;
+            default:
+                return MEM_GENERAL;
+        }
+    }
+
+    // Points asset->data at the contents: the mapped pack entry when it is stored, otherwise
+    // a copy unpacked or read into asset->bytes
+    bool fetch(Asset* asset) {
+        PackEntry entry;
+        if (pack && pack->find(asset->path, entry)) {
+            if (!entry.compressed) {
+                asset->data = entry.data;
+                asset->size = entry.size;
+                return true;
+            }
+            if (!AssetPack::unpack(entry, asset->bytes)) {
+                std::cerr << "Error: Pack entry " << asset->path << " is damaged." << std::endl;
+                return false;
+            }
+        } else {
+            std::ifstream in(asset->path, std::ios::binary);
+            if (!in.is_open()) {
+                std::cerr << "Error: Could not open " << asset->path << " for reading." << std::endl;
+                return false;
+            }
+            asset->bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (in.bad()) {
+                std::cerr << "Error: Failed reading " << asset->path << std::endl;
+                return false;
+            }
+        }
+        asset->data = asset->bytes.data();
+        asset->size = asset->bytes.size();
+        return true;
+    }
+
+    // Drops the contents once the decoded object no longer needs them
+    static void dropContents(Asset* asset) {
+        std::vector<unsigned char>().swap(asset->bytes);
+        asset->data = nullptr;
+        asset->size = 0;
+    }
+
+    // Worker thread: file I/O and everything that does not need the renderer
+    bool decode(Asset* asset) {
+        MemoryScope scope(tagFor(asset->type));
+        if (!fetch(asset))
+            return false;
+
+        switch (asset->type) {
+            case ASSET_TEXTURE:
+                asset->surface = IMG_Load_RW(SDL_RWFromConstMem(asset->data, (int)asset->size), 1);
+                dropContents(asset);
+                if (!asset->surface) {
+                    std::cerr << "Failed to load image " << asset->path << ": " << IMG_GetError() << std::endl;
+                    return false;
+                }
+                return true;
+            case ASSET_MUSIC:
+                // Music streams from its contents while it plays, so they stay with the asset
+                asset->music = Mix_LoadMUS_RW(SDL_RWFromConstMem(asset->data, (int)asset->size), 1);
+                if (!asset->music) {
+                    std::cerr << "Failed to load music " << asset->path << ": " << Mix_GetError() << std::endl;
+                    return false;
+                }
+                return true;
+            case ASSET_LEVEL:
+                parseLevelRows(std::string((const char*)asset->data, asset->size), asset->level);
+                dropContents(asset);
+                return true;
+            default:
+                return true;
+        }
+    }
+
+    // Main thread: the steps that need the renderer or the font library
+    void finish(Asset* asset) {
+        MemoryScope scope(tagFor(asset->type));
+        bool ok = true;
+        if (asset->type == ASSET_TEXTURE) {
+            asset->texture = renderer ? SDL_CreateTextureFromSurface(renderer, asset->surface) : nullptr;
+            SDL_FreeSurface(asset->surface);
+            asset->surface = nullptr;
+            if (!asset->texture) {
+                std::cerr << "Failed to create texture for " << asset->path << ": " << SDL_GetError() << std::endl;
+                ok = false;
+            }
+        } else if (asset->type == ASSET_FONT) {
+            asset->font = TTF_OpenFontRW(SDL_RWFromConstMem(asset->data, (int)asset->size), 1, asset->fontSize);
+            if (!asset->font) {
+                std::cerr << "Failed to load font " << asset->path << ": " << TTF_GetError() << std::endl;
+                ok = false;
+            }
+        }
+        asset->state.store(ok ? ASSET_READY : ASSET_FAILED, std::memory_order_release);
+    }
+
+    void removeFromFinishQueue(Asset* asset) {
+        std::vector<Pending> kept;
+        while (!finishQueue.empty()) {
+            if (finishQueue.top().asset != asset)
+                kept.push_back(finishQueue.top());
+            finishQueue.pop();
+        }
+        for (const Pending& pending : kept)
+            finishQueue.push(pending);
+    }
+
+    static void swapContents(Asset& a, Asset& b) {
+        std::swap(a.bytes, b.bytes);   // the buffers move with the vectors, so data stays valid
+        std::swap(a.data, b.data);
+        std::swap(a.size, b.size);
+        std::swap(a.surface, b.surface);
+        std::swap(a.texture, b.texture);
+        std::swap(a.music, b.music);
+        std::swap(a.font, b.font);
+        std::swap(a.level, b.level);
+    }
+
+    void release(Asset* asset) {
+        if (asset->texture)
+            SDL_DestroyTexture(asset->texture);
+        if (asset->music)
+            Mix_FreeMusic(asset->music);
+        if (asset->font)
+            TTF_CloseFont(asset->font);
+        if (asset->surface)
+            SDL_FreeSurface(asset->surface);
+        asset->texture = nullptr;
+        asset->music = nullptr;
+        asset->font = nullptr;
+        asset->surface = nullptr;
+        dropContents(asset);
+        LevelRows().swap(asset->level);
+    }
+};
+
+#endif
@@ -0,0 +1,435 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "save_game.h"
+
+// Asset packs: every shipped asset in one file, read through a memory mapping.
+//
+// Layout (little-endian):
+//   header   magic "GPAK", format version, entry count, name table size            16 bytes
+//   toc      one entry per asset, sorted by name:                                  24 bytes each
+//            data offset (uint64), stored size, original size, name offset, name length
+//            (uint16), flags (uint8), reserved (uint8)
+//   names    entry names, '/'-separated, not terminated
+//   data     entry contents, each starting on a PACK_ALIGNMENT boundary
+//
+// Entries flagged PACK_ENTRY_LZ4 hold one LZ4 block (standard block format, no frame
+// header); the rest are stored as-is and can be used straight from the mapping.
+
+const uint32_t PACK_FORMAT_VERSION = 1;
+const uint32_t PACK_ALIGNMENT = 16;
+const uint8_t PACK_ENTRY_LZ4 = 1;
+const uint32_t LZ4_MAX_RATIO = 255;   // a block never decodes to more than this times its size
+
+// Fixed-width little-endian fields, written and read the same on any host
+inline void storeLE(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+        out[i] = (unsigned char)(value >> (8 * i));
+}
+
+inline uint64_t loadLE(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+        value |= (uint64_t)in[i] << (8 * i);
+    return value;
+}
+
+// --- LZ4 block codec ---
+
+inline size_t lz4CompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+// Greedy single-pass compressor; dst must hold lz4CompressBound(size) bytes. Returns the
+// compressed size.
+inline size_t lz4Compress(const unsigned char* src, size_t size, unsigned char* dst) {
+    if (size == 0) {
+        dst[0] = 0;   // one token, no literals: the empty block
+        return 1;
+    }
+    const int HASH_BITS = 16;
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 65535;
+    std::vector<int64_t> table((size_t)1 << HASH_BITS, -1);
+
+    unsigned char* op = dst;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    auto writeLength = [&op](size_t length) {
+        for (; length >= 255; length -= 255)
+            *op++ = 255;
+        *op++ = (unsigned char)length;
+    };
+
+    // The format requires the last match to start 12 bytes before the end and the last 5
+    // bytes to be literals
+    if (size > 12) {
+        const size_t matchStartLimit = size - 12;
+        const size_t matchEndLimit = size - 5;
+        while (ip <= matchStartLimit) {
+            uint32_t sequence;
+            memcpy(&sequence, src + ip, 4);
+            size_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+            int64_t candidate = table[hash];
+            table[hash] = (int64_t)ip;
+
+            bool found = candidate >= 0 && ip - (size_t)candidate <= MAX_OFFSET && memcmp(src + candidate, src + ip, 4) == 0;
+            if (!found) {
+                ip += 1 + ((ip - anchor) >> 6);   // step faster through incompressible data
+                continue;
+            }
+
+            size_t ref = (size_t)candidate;
+            size_t length = MIN_MATCH;
+            while (ip + length < matchEndLimit && src[ref + length] == src[ip + length])
+                ++length;
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                --ip;
+                --ref;
+                ++length;
+            }
+
+            size_t literals = ip - anchor;
+            size_t extra = length - MIN_MATCH;
+            *op++ = (unsigned char)((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra, 15));
+            if (literals >= 15)
+                writeLength(literals - 15);
+            memcpy(op, src + anchor, literals);
+            op += literals;
+            size_t offset = ip - ref;
+            *op++ = (unsigned char)(offset & 0xFF);
+            *op++ = (unsigned char)(offset >> 8);
+            if (extra >= 15)
+                writeLength(extra - 15);
+
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    size_t literals = size - anchor;
+    *op++ = (unsigned char)(std::min<size_t>(literals, 15) << 4);
+    if (literals >= 15)
+        writeLength(literals - 15);
+    memcpy(op, src + anchor, literals);
+    op += literals;
+    return op - dst;
+}
+
+// Decodes one block into exactly dstSize bytes; false if the block is malformed or does not
+// decode to that size. Never reads or writes out of bounds.
+inline bool lz4Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize) {
+    if (dstSize == 0)
+        return srcSize == 1 && src[0] == 0;
+    size_t ip = 0;
+    size_t op = 0;
+
+    auto readLength = [&](size_t& length) {
+        unsigned char b;
+        do {
+            if (ip >= srcSize)
+                return false;
+            b = src[ip++];
+            length += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (ip < srcSize) {
+        unsigned char token = src[ip++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals))
+            return false;
+        if (literals > srcSize - ip || literals > dstSize - op)
+            return false;
+        memcpy(dst + op, src + ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == srcSize)
+            break;   // the last sequence has no match
+
+        if (srcSize - ip < 2)
+            return false;
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length))
+            return false;
+        length += 4;
+        if (offset == 0 || offset > op || length > dstSize - op)
+            return false;
+
+        const unsigned char* from = dst + op - offset;
+        if (offset >= length) {
+            memcpy(dst + op, from, length);
+        } else {
+            for (size_t i = 0; i < length; ++i)   // overlapping copy repeats the last `offset` bytes
+                dst[op + i] = from[i];
+        }
+        op += length;
+    }
+    return op == dstSize;
+}
+
+// --- Pack files ---
+
+struct PackEntry {
+    const unsigned char* data;   // points into the mapping
+    uint32_t storedSize;
+    uint32_t size;
+    bool compressed;
+};
+
+// Collects entries and writes the pack with a single pass
+class AssetPackWriter {
+public:
+    // Compresses the entry when allowed and it saves at least an eighth of its size
+    void addEntry(const std::string& name, const unsigned char* data, size_t size, bool allowCompression) {
+        Pending entry;
+        entry.name = name;
+        entry.size = (uint32_t)size;
+        entry.flags = 0;
+        if (allowCompression && size > 0) {
+            entry.bytes.resize(lz4CompressBound(size));
+            size_t packed = lz4Compress(data, size, entry.bytes.data());
+            if (packed < size - size / 8) {
+                entry.bytes.resize(packed);
+                entry.flags = PACK_ENTRY_LZ4;
+            }
+        }
+        if (entry.flags == 0)
+            entry.bytes.assign(data, data + size);
+        entries.push_back(std::move(entry));
+    }
+
+    bool writeFile(const std::string& path) {
+        std::sort(entries.begin(), entries.end(), [](const Pending& a, const Pending& b) { return a.name < b.name; });
+        for (size_t i = 1; i < entries.size(); ++i) {
+            if (entries[i - 1].name == entries[i].name) {
+                std::cerr << "Error: " << entries[i].name << " was added to the pack twice." << std::endl;
+                return false;
+            }
+        }
+
+        std::string names;
+        for (const Pending& entry : entries)
+            names += entry.name;
+        uint64_t dataStart = alignUp(HEADER_SIZE + entries.size() * ENTRY_SIZE + names.size());
+
+        std::vector<unsigned char> head(dataStart, 0);
+        memcpy(head.data(), "GPAK", 4);
+        storeLE(&head[4], PACK_FORMAT_VERSION, 4);
+        storeLE(&head[8], entries.size(), 4);
+        storeLE(&head[12], names.size(), 4);
+
+        uint64_t offset = dataStart;
+        uint32_t nameOffset = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const Pending& entry = entries[i];
+            unsigned char* out = &head[HEADER_SIZE + i * ENTRY_SIZE];
+            uint16_t nameLength = (uint16_t)entry.name.size();
+            storeLE(out, offset, 8);
+            storeLE(out + 8, entry.bytes.size(), 4);
+            storeLE(out + 12, entry.size, 4);
+            storeLE(out + 16, nameOffset, 4);
+            storeLE(out + 20, nameLength, 2);
+            out[22] = entry.flags;
+            nameOffset += nameLength;
+            offset = alignUp(offset + entry.bytes.size());
+        }
+        memcpy(&head[HEADER_SIZE + entries.size() * ENTRY_SIZE], names.data(), names.size());
+
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+            return false;
+        }
+        bool ok = fwrite(head.data(), 1, head.size(), out) == head.size();
+        static const unsigned char padding[PACK_ALIGNMENT] = {};
+        for (const Pending& entry : entries) {
+            if (!ok)
+                break;
+            size_t pad = alignUp(entry.bytes.size()) - entry.bytes.size();
+            ok = (entry.bytes.empty() || fwrite(entry.bytes.data(), 1, entry.bytes.size(), out) == entry.bytes.size())
+                && fwrite(padding, 1, pad, out) == pad;
+        }
+        ok = fclose(out) == 0 && ok;
+        if (!ok)
+            std::cerr << "Error: Failed writing " << path << std::endl;
+        return ok;
+    }
+
+    static constexpr uint32_t HEADER_SIZE = 16;
+    static constexpr uint32_t ENTRY_SIZE = 24;
+
+private:
+    struct Pending {
+        std::string name;
+        uint32_t size;
+        uint8_t flags;
+        std::vector<unsigned char> bytes;
+    };
+
+    std::vector<Pending> entries;
+
+    static uint64_t alignUp(uint64_t value) {
+        return (value + PACK_ALIGNMENT - 1) & ~(uint64_t)(PACK_ALIGNMENT - 1);
+    }
+};
+
+// Read-only view of a mapped pack; open() validates the table so lookups can trust it
+class AssetPack {
+public:
+    AssetPack() : count(0), names(nullptr), namesSize(0) {}
+
+    // On failure the pack is left closed, so isOpen() tells whether it can be used
+    bool open(const std::string& path) {
+        count = 0;
+        names = nullptr;
+        if (!file.open(path))
+            return false;
+        if (!readTable(path)) {
+            count = 0;
+            names = nullptr;
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const {
+        return file.bytes() != nullptr;
+    }
+
+    uint32_t entryCount() const {
+        return count;
+    }
+
+    // Binary search on the name-sorted table
+    bool find(const std::string& name, PackEntry& out) const {
+        uint32_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (compareName(mid, name) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo == count || compareName(lo, name) != 0)
+            return false;
+
+        Entry entry = entryAt(lo);
+        out.data = file.bytes() + entry.offset;
+        out.storedSize = entry.storedSize;
+        out.size = entry.size;
+        out.compressed = (entry.flags & PACK_ENTRY_LZ4) != 0;
+        return true;
+    }
+
+    // Decompresses a compressed entry into `out`; false if the block is damaged
+    static bool unpack(const PackEntry& entry, std::vector<unsigned char>& out) {
+        out.resize(entry.size);
+        if (!entry.compressed) {
+            if (entry.size > 0)
+                memcpy(out.data(), entry.data, entry.size);
+            return true;
+        }
+        return lz4Decompress(entry.data, entry.storedSize, out.data(), entry.size);
+    }
+
+private:
+    struct Entry {
+        uint64_t offset;
+        uint32_t storedSize;
+        uint32_t size;
+        uint32_t nameOffset;
+        uint16_t nameLength;
+        uint8_t flags;
+    };
+
+    MappedFile file;
+    uint32_t count;
+    const char* names;
+    uint32_t namesSize;
+
+    Entry entryAt(uint32_t index) const {
+        const unsigned char* in = file.bytes() + AssetPackWriter::HEADER_SIZE + (size_t)index * AssetPackWriter::ENTRY_SIZE;
+        Entry entry;
+        entry.offset = loadLE(in, 8);
+        entry.storedSize = (uint32_t)loadLE(in + 8, 4);
+        entry.size = (uint32_t)loadLE(in + 12, 4);
+        entry.nameOffset = (uint32_t)loadLE(in + 16, 4);
+        entry.nameLength = (uint16_t)loadLE(in + 20, 2);
+        entry.flags = in[22];
+        return entry;
+    }
+
+    // Checks the header and every table entry against the mapped size
+    bool readTable(const std::string& path) {
+        const unsigned char* data = file.bytes();
+        size_t size = file.length();
+        uint32_t header[4];
+        if (size < AssetPackWriter::HEADER_SIZE || memcmp(data, "GPAK", 4) != 0) {
+            std::cerr << "Error: " << path << " is not an asset pack." << std::endl;
+            return false;
+        }
+        for (int i = 1; i < 4; ++i)
+            header[i] = (uint32_t)loadLE(data + 4 * i, 4);
+        if (header[1] > PACK_FORMAT_VERSION) {
+            std::cerr << "Error: " << path << " was written by a newer version (" << header[1] << ")." << std::endl;
+            return false;
+        }
+
+        uint64_t namesStart = AssetPackWriter::HEADER_SIZE + (uint64_t)header[2] * AssetPackWriter::ENTRY_SIZE;
+        if (namesStart + header[3] > size) {
+            std::cerr << "Error: " << path << " is truncated." << std::endl;
+            return false;
+        }
+        names = (const char*)data + namesStart;
+        namesSize = header[3];
+        count = header[2];
+        for (uint32_t i = 0; i < count; ++i) {
+            if (!validEntry(i, size) || (i > 0 && compareName(i, nameAt(i - 1)) <= 0)) {
+                std::cerr << "Error: " << path << " has a damaged table of contents." << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string nameAt(uint32_t index) const {
+        Entry entry = entryAt(index);
+        return std::string(names + entry.nameOffset, entry.nameLength);
+    }
+
+    // Orders like std::string comparison, without building a string from the table
+    int compareName(uint32_t index, const std::string& name) const {
+        Entry entry = entryAt(index);
+        int order = memcmp(names + entry.nameOffset, name.data(), std::min<size_t>(entry.nameLength, name.size()));
+        if (order != 0)
+            return order;
+        return entry.nameLength < name.size() ? -1 : (entry.nameLength > name.size() ? 1 : 0);
+    }
+
+    bool validEntry(uint32_t index, size_t size) const {
+        Entry entry = entryAt(index);
+        if ((uint64_t)entry.nameOffset + entry.nameLength > namesSize)
+            return false;
+        if (entry.offset % PACK_ALIGNMENT != 0 || entry.offset > size || size - entry.offset < entry.storedSize)
+            return false;
+        if (entry.flags & PACK_ENTRY_LZ4)
+            return entry.storedSize > 0 && entry.size <= (uint64_t)entry.storedSize * LZ4_MAX_RATIO;
+        return entry.storedSize == entry.size;
+    }
+};
+
+#endif
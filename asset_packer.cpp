@@ -0,0 +1,69 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "asset_pack.h"
+
+using namespace std;
+
+// Builds an asset pack from loose files. Entries are named by the path given on the command
+// line, with '\' turned into '/' and any leading "./" dropped, so the engine finds them under
+// the names it loads by. Paths must be relative to the game directory.
+//
+// Usage: packer <output.pak> [--store] <file>...
+//   --store   keep every entry uncompressed (by default entries are LZ4-compressed when it
+//             saves at least an eighth of their size)
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <output.pak> [--store] <file>..." << endl;
+        return 1;
+    }
+
+    AssetPackWriter writer;
+    bool allowCompression = true;
+    size_t totalSize = 0;
+    for (int i = 2; i < argc; ++i) {
+        string path = argv[i];
+        if (path == "--store") {
+            allowCompression = false;
+            continue;
+        }
+
+        string name = path;
+        for (char& c : name) {
+            if (c == '\\') {
+                c = '/';
+            }
+        }
+        while (name.compare(0, 2, "./") == 0) {
+            name.erase(0, 2);
+        }
+        if (name.empty() || name[0] == '/' || (name.size() > 1 && name[1] == ':')) {
+            cerr << "Error: " << path << " is not a path relative to the game directory." << endl;
+            return 1;
+        }
+
+        ifstream in(path, ios::binary);
+        if (!in.is_open()) {
+            cerr << "Error: Could not open " << path << " for reading." << endl;
+            return 1;
+        }
+        vector<unsigned char> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+        writer.addEntry(name, bytes.data(), bytes.size(), allowCompression);
+        totalSize += bytes.size();
+    }
+
+    if (!writer.writeFile(argv[1])) {
+        return 1;
+    }
+
+    AssetPack pack;
+    if (!pack.open(argv[1])) {
+        return 1;
+    }
+    cout << "Packed " << pack.entryCount() << " assets (" << totalSize << " bytes) into " << argv[1] << endl;
+    return 0;
+}
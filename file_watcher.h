@@ -0,0 +1,145 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Reports files that changed on disk, for hot reloading. poll() never blocks and is meant to
+// be called once per frame.
+//
+// On Linux the watcher uses inotify on each file's directory and reports a file when it is
+// closed after writing or renamed into place, so editors that save through a temporary file
+// are seen too, and a half-written file is never reported. Elsewhere it compares each file's
+// modification time and size, at most every POLL_INTERVAL.
+class FileWatcher {
+public:
+    FileWatcher() {
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+            std::cerr << "Error: inotify unavailable: " << strerror(errno) << std::endl;
+#else
+        lastPoll = std::chrono::steady_clock::now();
+#endif
+    }
+
+    ~FileWatcher() {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Paths are reported exactly as given here
+    bool watch(const std::string& path) {
+#ifdef __linux__
+        size_t slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        if (fd < 0)
+            return false;
+        int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            std::cerr << "Error: Could not watch " << directory << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        watched.push_back({path, name, wd});
+#else
+        watched.push_back({path, 0, 0, false});
+        stamp(watched.back());
+#endif
+        return true;
+    }
+
+    // Appends each watched path that changed since the last call, once
+    void poll(std::vector<std::string>& changed) {
+        size_t first = changed.size();
+#ifdef __linux__
+        if (fd < 0)
+            return;
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;   // EAGAIN: nothing more queued
+            for (ssize_t at = 0; at < length;) {
+                const inotify_event* event = (const inotify_event*)(buffer + at);
+                if (event->mask & IN_Q_OVERFLOW) {
+                    for (const Watched& file : watched)
+                        changed.push_back(file.path);
+                } else if (event->len > 0) {
+                    for (const Watched& file : watched) {
+                        if (file.wd == event->wd && file.name == event->name)
+                            changed.push_back(file.path);
+                    }
+                }
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+#else
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastPoll < POLL_INTERVAL)
+            return;
+        lastPoll = now;
+        for (Watched& file : watched) {
+            if (stamp(file))
+                changed.push_back(file.path);
+        }
+#endif
+        std::sort(changed.begin() + first, changed.end());
+        changed.erase(std::unique(changed.begin() + first, changed.end()), changed.end());
+    }
+
+private:
+#ifdef __linux__
+    struct Watched {
+        std::string path;
+        std::string name;   // within the watched directory
+        int wd;
+    };
+
+    int fd;
+#else
+    struct Watched {
+        std::string path;
+        long long modified;
+        long long size;
+        bool exists;
+    };
+
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{250};
+    std::chrono::steady_clock::time_point lastPoll;
+
+    // Refreshes the file's stamp; true if it differs from the previous one
+    static bool stamp(Watched& file) {
+        struct stat info;
+        bool exists = stat(file.path.c_str(), &info) == 0;
+        long long modified = exists ? (long long)info.st_mtime : 0;
+        long long size = exists ? (long long)info.st_size : 0;
+        bool different = exists != file.exists || modified != file.modified || size != file.size;
+        file.exists = exists;
+        file.modified = modified;
+        file.size = size;
+        return different && exists;
+    }
+#endif
+
+    std::vector<Watched> watched;
+};
+
+#endif
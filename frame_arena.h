@@ -0,0 +1,137 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "memory_tracker.h"
+
+// Linear scratch memory for one frame. allocate() bumps a pointer through one block and
+// reset() at the end of the frame makes all of it free again at once; nothing is freed
+// individually. A frame that outgrows the block spills into extra blocks, and the next
+// reset() replaces the block with one big enough for that frame, so a steady workload
+// settles into a single block and never calls the heap.
+//
+// Each thread has its own arena (forThread()). Memory from it, and containers using
+// FrameAllocator, must not be used after the reset that ends the frame. Block and spill
+// memory is charged to MEM_FRAME in the MemoryTracker.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = 256 * 1024)
+        : tracker(MemoryTracker::instance()), block(new unsigned char[capacity]), capacity(capacity), offset(0), spilled(0), peak(0) {
+        tracker.recordAlloc(MEM_FRAME, capacity);
+    }
+
+    ~FrameArena() {
+        tracker.recordFree(MEM_FRAME, capacity + spilled);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        uintptr_t base = (uintptr_t)block.get();
+        size_t start = ((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base;
+        if (start + size <= capacity) {
+            offset = start + size;
+            return block.get() + start;
+        }
+
+        // Spill: a separate block for this allocation, released at reset()
+        spilled += size + align;
+        overflow.emplace_back(new unsigned char[size + align]);
+        tracker.recordAlloc(MEM_FRAME, size + align);
+        uintptr_t raw = (uintptr_t)overflow.back().get();
+        return (void*)((raw + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    template <class T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Ends the frame: everything handed out since the last reset is invalid afterwards
+    void reset() {
+        size_t frameBytes = offset + spilled;
+        if (frameBytes > peak)
+            peak = frameBytes;
+        if (spilled > 0) {
+            overflow.clear();
+            tracker.recordFree(MEM_FRAME, capacity + spilled);
+            capacity = frameBytes + frameBytes / 2;
+            block.reset(new unsigned char[capacity]);
+            tracker.recordAlloc(MEM_FRAME, capacity);
+        }
+        offset = 0;
+        spilled = 0;
+    }
+
+    size_t used() const {
+        return offset + spilled;
+    }
+
+    // Most bytes any finished frame used
+    size_t highWater() const {
+        return peak;
+    }
+
+    size_t blockSize() const {
+        return capacity;
+    }
+
+    static FrameArena& forThread() {
+        static thread_local FrameArena arena;
+        return arena;
+    }
+
+private:
+    MemoryTracker& tracker;
+    std::unique_ptr<unsigned char[]> block;
+    size_t capacity;
+    size_t offset;
+    std::vector<std::unique_ptr<unsigned char[]>> overflow;
+    size_t spilled;
+    size_t peak;
+};
+
+// STL allocator over a FrameArena; deallocate() is a no-op and reset() reclaims everything.
+// Default-constructed allocators use the calling thread's arena.
+template <class T>
+class FrameAllocator {
+public:
+    typedef T value_type;
+
+    FrameAllocator() : arena(&FrameArena::forThread()) {}
+    explicit FrameAllocator(FrameArena& arena) : arena(&arena) {}
+
+    template <class U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return arena->allocateArray<T>(n);
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template <class U>
+    bool operator==(const FrameAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    template <class U>
+    bool operator!=(const FrameAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+
+private:
+    template <class> friend class FrameAllocator;
+    FrameArena* arena;
+};
+
+template <class T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
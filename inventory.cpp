@@ -1,247 +1,836 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <climits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "save_game.h"
+#include "pool_allocator.h"
 using namespace std;
 
-class GameItem {
+typedef uint32_t ItemId;
+const ItemId INVALID_ITEM = 0xFFFFFFFFu;
+
+// Interns item names to dense ids so inventories compare integers instead of strings.
+// Register the item catalogue at load time; unknown names are interned on first use.
+class ItemRegistry {
 public:
-    string name;
-    int quantity;
+    ItemId intern(const string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end())
+            return it->second;
+        ItemId id = names.size();
+        names.push_back(name);
+        ids.emplace(name, id);
+        return id;
+    }
+
+    // INVALID_ITEM when the name was never registered
+    ItemId find(const string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? INVALID_ITEM : it->second;
+    }
 
-    GameItem(string n, int q) : name(n), quantity(q) {}
+    const string& name(ItemId id) const {
+        return names[id];
+    }
 
-    void displayItem() {
-        cout << name << " (" << quantity << ")" << endl;
+    int size() const {
+        return names.size();
     }
+
+private:
+    vector<string> names;
+    unordered_map<string, ItemId> ids;
 };
 
+class GameItem {
+public:
+    ItemId id;
+    int quantity;
+
+    GameItem(ItemId id, int q) : id(id), quantity(q) {}
+};
+
+// Tree node with the item stored inline; children are indices into the tree's node arena
 class AVLNode {
 public:
-    GameItem* item;
-    AVLNode* left;
-    AVLNode* right;
+    GameItem item;
+    int left;
+    int right;
     int height;
 
-    AVLNode(GameItem* item) : item(item), left(nullptr), right(nullptr), height(1) {}
+    AVLNode(const GameItem& item) : item(item), left(-1), right(-1), height(1) {}
 };
 
+// Inventory keyed on interned item ids; Inventory puts item names in front of it
 class AVLTree {
 public:
-    AVLNode* root;
+    int root;
+
+    AVLTree() : root(-1), itemCount(0), usedNodes(0), freeHead(-1) {}
 
-    AVLTree() : root(nullptr) {}
+    int size() const {
+        return itemCount;
+    }
+
+    // Drops every item in O(1); node slots are kept for reuse
+    void clear() {
+        root = -1;
+        itemCount = 0;
+        usedNodes = 0;
+        freeHead = -1;
+    }
 
-    int getHeight(AVLNode* node) {
-        if (node == nullptr)
+    int getHeight(int node) {
+        if (node == -1)
             return 0;
-        return node->height;
+        return nodes[node].height;
     }
 
-    int getBalance(AVLNode* node) {
-        if (node == nullptr)
+    int getBalance(int node) {
+        if (node == -1)
             return 0;
-        return getHeight(node->left) - getHeight(node->right);
+        return getHeight(nodes[node].left) - getHeight(nodes[node].right);
     }
 
-    AVLNode* rightRotate(AVLNode* y) {
-        AVLNode* x = y->left;
-        AVLNode* T2 = x->right;
+    void updateHeight(int node) {
+        nodes[node].height = 1 + max(getHeight(nodes[node].left), getHeight(nodes[node].right));
+    }
+
+    int rightRotate(int y) {
+        int x = nodes[y].left;
+        int T2 = nodes[x].right;
 
-        x->right = y;
-        y->left = T2;
+        nodes[x].right = y;
+        nodes[y].left = T2;
 
-        y->height = 1 + max(getHeight(y->left), getHeight(y->right));
-        x->height = 1 + max(getHeight(x->left), getHeight(x->right));
+        updateHeight(y);
+        updateHeight(x);
 
         return x;
     }
 
-    AVLNode* leftRotate(AVLNode* x) {
-        AVLNode* y = x->right;
-        AVLNode* T2 = y->left;
+    int leftRotate(int x) {
+        int y = nodes[x].right;
+        int T2 = nodes[y].left;
 
-        y->left = x;
-        x->right = T2;
+        nodes[y].left = x;
+        nodes[x].right = T2;
 
-        x->height = 1 + max(getHeight(x->left), getHeight(x->right));
-        y->height = 1 + max(getHeight(y->left), getHeight(y->right));
+        updateHeight(x);
+        updateHeight(y);
 
         return y;
     }
 
-    AVLNode* insert(AVLNode* node, GameItem* item) {
-        if (node == nullptr)
-            return new AVLNode(item);
-
-        if (item->name < node->item->name)
-            node->left = insert(node->left, item);
-        else if (item->name > node->item->name)
-            node->right = insert(node->right, item);
-        else {
-            node->item->quantity += item->quantity;
-            return node;
-        }
-
-        node->height = 1 + max(getHeight(node->left), getHeight(node->right));
+    int rebalance(int node) {
+        updateHeight(node);
 
         int balance = getBalance(node);
 
         if (balance > 1) {
-            if (item->name < node->left->item->name)
-                return rightRotate(node);
-            else {
-                node->left = leftRotate(node->left);
-                return rightRotate(node);
-            }
+            if (getBalance(nodes[node].left) < 0)
+                nodes[node].left = leftRotate(nodes[node].left);
+            return rightRotate(node);
         }
 
         if (balance < -1) {
-            if (item->name > node->right->item->name)
-                return leftRotate(node);
-            else {
-                node->right = rightRotate(node->right);
-                return leftRotate(node);
-            }
+            if (getBalance(nodes[node].right) > 0)
+                nodes[node].right = rightRotate(nodes[node].right);
+            return leftRotate(node);
         }
 
         return node;
     }
 
-    void addItem(string name, int quantity) {
-        GameItem* item = new GameItem(name, quantity);
-        root = insert(root, item);
-        cout << "Added: " << name << " (" << quantity << ")" << endl;
+    int insert(int node, ItemId id, int quantity) {
+        if (node == -1)
+            return allocNode(GameItem(id, quantity));
+
+        if (id < nodes[node].item.id) {
+            int child = insert(nodes[node].left, id, quantity);
+            nodes[node].left = child;
+        } else if (id > nodes[node].item.id) {
+            int child = insert(nodes[node].right, id, quantity);
+            nodes[node].right = child;
+        } else {
+            nodes[node].item.quantity += quantity;
+            return node;
+        }
+
+        return rebalance(node);
+    }
+
+    void addItem(ItemId id, int quantity) {
+        root = insert(root, id, quantity);
     }
 
-    AVLNode* findMinNode(AVLNode* node) {
-        AVLNode* current = node;
-        while (current->left != nullptr)
-            current = current->left;
+    int findMinNode(int node) {
+        int current = node;
+        while (nodes[current].left != -1)
+            current = nodes[current].left;
         return current;
     }
 
-    AVLNode* remove(AVLNode* node, GameItem* item) {
-        if (node == nullptr)
+    // Takes quantity off the item, unlinking it once nothing is left (quantity < 0 always unlinks)
+    int remove(int node, ItemId id, int quantity) {
+        if (node == -1)
             return node;
 
-        if (item->name < node->item->name)
-            node->left = remove(node->left, item);
-        else if (item->name > node->item->name)
-            node->right = remove(node->right, item);
+        if (id < nodes[node].item.id)
+            nodes[node].left = remove(nodes[node].left, id, quantity);
+        else if (id > nodes[node].item.id)
+            nodes[node].right = remove(nodes[node].right, id, quantity);
         else {
-            if (item->quantity < node->item->quantity) {
-                node->item->quantity -= item->quantity;
+            if (quantity >= 0 && quantity < nodes[node].item.quantity) {
+                nodes[node].item.quantity -= quantity;
                 return node;
             }
-            if (node->left == nullptr || node->right == nullptr) {
-                AVLNode* temp = node->left ? node->left : node->right;
-
-                if (temp == nullptr) {
-                    temp = node;
-                    node = nullptr;
-                } else {
-                    *node = *temp;
-                }
-
-                delete temp;
-            } else {
-                AVLNode* temp = findMinNode(node->right);
-                node->item = temp->item;
-                node->right = remove(node->right, temp->item);
+            if (nodes[node].left == -1 || nodes[node].right == -1) {
+                int child = nodes[node].left != -1 ? nodes[node].left : nodes[node].right;
+                freeNode(node);
+                return child;
             }
+
+            int successor = findMinNode(nodes[node].right);
+            nodes[node].item = nodes[successor].item;
+            nodes[node].right = remove(nodes[node].right, nodes[node].item.id, -1);
         }
 
-        if (node == nullptr)
-            return node;
+        return rebalance(node);
+    }
 
-        node->height = 1 + max(getHeight(node->left), getHeight(node->right));
+    int search(int node, ItemId id) const {
+        while (node != -1 && nodes[node].item.id != id)
+            node = id < nodes[node].item.id ? nodes[node].left : nodes[node].right;
+        return node;
+    }
 
-        int balance = getBalance(node);
+    // Replaces the contents with items already sorted by id, building a balanced tree in O(n)
+    void assignSorted(const vector<GameItem>& items) {
+        clear();
+        root = buildBalanced(items, 0, items.size());
+    }
 
-        if (balance > 1) {
-            if (getBalance(node->left) >= 0)
-                return rightRotate(node);
-            else {
-                node->left = leftRotate(node->left);
-                return rightRotate(node);
-            }
-        }
+    // Calls visit(item) for every item with first <= id <= last, in id order
+    template <class Visit>
+    void forEachInRange(int node, ItemId first, ItemId last, Visit& visit) const {
+        if (node == -1)
+            return;
+        const GameItem& item = nodes[node].item;
+        if (first < item.id)
+            forEachInRange(nodes[node].left, first, last, visit);
+        if (first <= item.id && item.id <= last)
+            visit(item);
+        if (item.id < last)
+            forEachInRange(nodes[node].right, first, last, visit);
+    }
 
-        if (balance < -1) {
-            if (getBalance(node->right) <= 0)
-                return leftRotate(node);
-            else {
-                node->right = rightRotate(node->right);
-                return leftRotate(node);
-            }
+    int getTotalQuantity(ItemId id) const {
+        int node = search(root, id);
+        return node == -1 ? 0 : nodes[node].item.quantity;
+    }
+
+    void removeItem(ItemId id, int quantity) {
+        root = remove(root, id, quantity);
+    }
+
+private:
+    int itemCount;
+    vector<AVLNode> nodes;   // node arena; slots past usedNodes are left over from before clear()
+    int usedNodes;
+    int freeHead;            // a freed slot links to the next free one through `left`
+
+    int allocNode(const GameItem& item) {
+        ++itemCount;
+        int node;
+        if (freeHead != -1) {
+            node = freeHead;
+            freeHead = nodes[node].left;
+        } else if (usedNodes < (int)nodes.size()) {
+            node = usedNodes++;
+        } else {
+            nodes.push_back(AVLNode(item));
+            return usedNodes++;
         }
+        nodes[node].item = item;
+        nodes[node].left = -1;
+        nodes[node].right = -1;
+        nodes[node].height = 1;
+        return node;
+    }
 
+    int buildBalanced(const vector<GameItem>& items, int first, int last) {
+        if (first >= last)
+            return -1;
+        int mid = first + (last - first) / 2;
+        int node = allocNode(items[mid]);
+        int left = buildBalanced(items, first, mid);
+        int right = buildBalanced(items, mid + 1, last);
+        nodes[node].left = left;
+        nodes[node].right = right;
+        updateHeight(node);
         return node;
     }
 
-    AVLNode* search(AVLNode* node, string name) {
-        if (node == nullptr || node->item->name == name)
-            return node;
+    void freeNode(int node) {
+        --itemCount;
+        nodes[node].left = freeHead;
+        freeHead = node;
+    }
+};
 
-        if (name < node->item->name)
-            return search(node->left, name);
+// Small-inventory container: items sorted by id in one contiguous array,
+// so a typical player inventory is searched within a few cache lines
+class FlatInventory {
+public:
+    int size() const {
+        return items.size();
+    }
+
+    void clear() {
+        items.clear();
+    }
+
+    void addItem(ItemId id, int quantity) {
+        auto it = lowerBound(id);
+        if (it != items.end() && it->id == id)
+            it->quantity += quantity;
         else
-            return search(node->right, name);
+            items.insert(it, GameItem(id, quantity));
     }
 
-    void displayInOrder(AVLNode* node) {
-        if (node) {
-            displayInOrder(node->left);
-            node->item->displayItem();
-            displayInOrder(node->right);
+    // Same semantics as AVLTree::remove: the item goes once its quantity runs out
+    void removeItem(ItemId id, int quantity) {
+        auto it = lowerBound(id);
+        if (it == items.end() || it->id != id)
+            return;
+        if (quantity < it->quantity)
+            it->quantity -= quantity;
+        else
+            items.erase(it);
+    }
+
+    int getTotalQuantity(ItemId id) const {
+        auto it = lowerBound(id);
+        return it != items.end() && it->id == id ? it->quantity : 0;
+    }
+
+    const vector<GameItem>& sortedItems() const {
+        return items;
+    }
+
+    // Takes over a vector of items already sorted by id
+    void assignSorted(vector<GameItem>& sorted) {
+        items.swap(sorted);
+    }
+
+    template <class Visit>
+    void forEachInRange(ItemId first, ItemId last, Visit& visit) const {
+        for (auto it = lowerBound(first); it != items.end() && it->id <= last; ++it)
+            visit(*it);
+    }
+
+private:
+    vector<GameItem> items;
+
+    vector<GameItem>::iterator lowerBound(ItemId id) {
+        return lower_bound(items.begin(), items.end(), id, [](const GameItem& item, ItemId key) { return item.id < key; });
+    }
+
+    vector<GameItem>::const_iterator lowerBound(ItemId id) const {
+        return lower_bound(items.begin(), items.end(), id, [](const GameItem& item, ItemId key) { return item.id < key; });
+    }
+};
+
+// One line of a batch: positive quantities add items, negative ones take them away
+struct ItemDelta {
+    ItemId id;
+    int quantity;
+};
+
+// Function to merge deltas into items sorted by id in one pass; false when a removal
+// asks for more than is held or a stack would exceed INT_MAX. Items whose quantity
+// reaches zero are dropped.
+bool mergeItemDeltas(const vector<GameItem>& current, const vector<ItemDelta>& deltas, vector<GameItem>& result) {
+    vector<ItemDelta> sorted(deltas);
+    sort(sorted.begin(), sorted.end(), [](const ItemDelta& a, const ItemDelta& b) { return a.id < b.id; });
+
+    result.clear();
+    result.reserve(current.size() + sorted.size());
+    size_t i = 0, k = 0;
+    while (i < current.size() || k < sorted.size()) {
+        ItemId id = k == sorted.size() || (i < current.size() && current[i].id < sorted[k].id) ? current[i].id : sorted[k].id;
+        long long quantity = 0;
+        if (i < current.size() && current[i].id == id)
+            quantity = current[i++].quantity;
+        for (; k < sorted.size() && sorted[k].id == id; ++k)
+            quantity += sorted[k].quantity;
+
+        if (quantity < 0 || quantity > INT_MAX)
+            return false;
+        if (quantity > 0)
+            result.push_back(GameItem(id, (int)quantity));
+    }
+    return true;
+}
+
+// Player inventory that keeps items in a FlatInventory while it holds at most flatLimit
+// of them and moves to the AVLTree beyond that (and back once it shrinks to half)
+class Inventory {
+public:
+    Inventory(ItemRegistry& registry, int flatLimit = 64)
+        : registry(registry), flatLimit(flatLimit), useTree(false) {}
+
+    int size() const {
+        return useTree ? tree.size() : flat.size();
+    }
+
+    void addItem(ItemId id, int quantity) {
+        if (useTree) {
+            tree.addItem(id, quantity);
+            return;
         }
+        flat.addItem(id, quantity);
+        if (flat.size() > flatLimit)
+            moveToTree();
     }
 
-    int getTotalQuantity(AVLNode* node, string name) {
-        if (node == nullptr)
-            return 0;
+    void removeItem(ItemId id, int quantity) {
+        if (!useTree) {
+            flat.removeItem(id, quantity);
+            return;
+        }
+        tree.removeItem(id, quantity);
+        if (tree.size() <= flatLimit / 2)
+            moveToFlat();
+    }
+
+    int getTotalQuantity(ItemId id) const {
+        return useTree ? tree.getTotalQuantity(id) : flat.getTotalQuantity(id);
+    }
 
-        if (name < node->item->name)
-            return getTotalQuantity(node->left, name);
-        else if (name > node->item->name)
-            return getTotalQuantity(node->right, name);
+    // Calls visit(item) for every item with first <= id <= last, in id order
+    template <class Visit>
+    void forEachInRange(ItemId first, ItemId last, Visit visit) const {
+        if (useTree)
+            tree.forEachInRange(tree.root, first, last, visit);
         else
-            return node->item->quantity;
+            flat.forEachInRange(first, last, visit);
     }
 
-    void displayInventory() {
-        if (root == nullptr) {
-            cout << "Inventory is empty." << endl;
+    // A batch checked against the current contents and ready to apply. A flat inventory
+    // is rebuilt in one merge pass; a tree only updates the items the batch touches.
+    struct PreparedBatch {
+        vector<GameItem> items;   // the whole new item list, or the touched items' new quantities
+        bool inPlace;
+    };
+
+    // Applies every delta or none of them: fails, leaving the inventory untouched, when a
+    // removal asks for more than is held or a stack would overflow
+    bool applyBatch(const vector<ItemDelta>& deltas) {
+        PreparedBatch batch;
+        if (!prepareBatch(deltas, batch))
+            return false;
+        commitBatch(batch);
+        return true;
+    }
+
+    // Trade: `gives` leaves this inventory for `other`, `receives` comes back; all or nothing.
+    // An inventory cannot trade with itself.
+    bool trade(Inventory& other, const vector<ItemDelta>& gives, const vector<ItemDelta>& receives) {
+        if (&other == this)
+            return false;
+        vector<ItemDelta> mine, theirs;
+        for (const ItemDelta& d : gives) {
+            mine.push_back({d.id, -d.quantity});
+            theirs.push_back({d.id, d.quantity});
+        }
+        for (const ItemDelta& d : receives) {
+            mine.push_back({d.id, d.quantity});
+            theirs.push_back({d.id, -d.quantity});
+        }
+
+        PreparedBatch myBatch, theirBatch;
+        if (!prepareBatch(mine, myBatch) || !other.prepareBatch(theirs, theirBatch))
+            return false;
+        commitBatch(myBatch);
+        other.commitBatch(theirBatch);
+        return true;
+    }
+
+    // Checks the batch and works out its effect without changing the inventory. For a tree
+    // this costs O(k log n) for k deltas rather than a pass over every item.
+    bool prepareBatch(const vector<ItemDelta>& deltas, PreparedBatch& batch) const {
+        batch.inPlace = useTree;
+        if (!useTree)
+            return mergeItemDeltas(flat.sortedItems(), deltas, batch.items);
+
+        vector<ItemDelta> sorted(deltas);
+        sort(sorted.begin(), sorted.end(), [](const ItemDelta& a, const ItemDelta& b) { return a.id < b.id; });
+        batch.items.clear();
+        for (size_t k = 0; k < sorted.size();) {
+            ItemId id = sorted[k].id;
+            long long quantity = tree.getTotalQuantity(id);
+            for (; k < sorted.size() && sorted[k].id == id; ++k)
+                quantity += sorted[k].quantity;
+            if (quantity < 0 || quantity > INT_MAX)
+                return false;
+            batch.items.push_back(GameItem(id, (int)quantity));
+        }
+        return true;
+    }
+
+    // Installs a batch from prepareBatch
+    void commitBatch(PreparedBatch& batch) {
+        if (!batch.inPlace) {
+            commitBatch(batch.items);
+            return;
+        }
+        for (const GameItem& item : batch.items) {
+            int held = tree.getTotalQuantity(item.id);
+            if (item.quantity == 0)
+                tree.removeItem(item.id, -1);
+            else if (item.quantity > held)
+                tree.addItem(item.id, item.quantity - held);
+            else if (item.quantity < held)
+                tree.removeItem(item.id, held - item.quantity);
+        }
+        if (tree.size() <= flatLimit / 2)
+            moveToFlat();
+    }
+
+    // Items in id order, for saving
+    void exportSorted(vector<SavedItem>& out) const {
+        out.clear();
+        out.reserve(size());
+        forEachInRange(0, INVALID_ITEM - 1, [&out](const GameItem& item) { out.push_back({item.id, item.quantity}); });
+    }
+
+    // Replaces the contents with saved items (sorted by id) without per-item inserts
+    void loadSorted(const SavedItem* items, uint32_t count) {
+        vector<GameItem> sorted;
+        sorted.reserve(count);
+        for (uint32_t i = 0; i < count; ++i)
+            sorted.push_back(GameItem(items[i].id, items[i].quantity));
+        commitBatch(sorted);
+    }
+
+    // Replaces the contents with items sorted by id, picking the backend for the new size
+    void commitBatch(vector<GameItem>& result) {
+        if ((int)result.size() > flatLimit) {
+            flat.clear();
+            tree.assignSorted(result);
+            useTree = true;
         } else {
-            cout << "Inventory:" << endl;
-            displayInOrder(root);
+            tree.clear();
+            flat.assignSorted(result);
+            useTree = false;
         }
     }
 
-    void removeItem(string name, int quantity) {
-        GameItem* item = new GameItem(name, quantity);
-        root = remove(root, item);
+    void addItem(const string& name, int quantity) {
+        addItem(registry.intern(name), quantity);
+        cout << "Added: " << name << " (" << quantity << ")" << endl;
+    }
+
+    void removeItem(const string& name, int quantity) {
+        ItemId id = registry.find(name);
+        if (id != INVALID_ITEM)
+            removeItem(id, quantity);
         cout << "Removed: " << name << " (" << quantity << ")" << endl;
     }
 
-    void searchItem(string name) {
-        AVLNode* result = search(root, name);
-        if (result)
-            cout << "Found: " << result->item->name << " (" << result->item->quantity << ")" << endl;
+    int getTotalQuantity(const string& name) const {
+        ItemId id = registry.find(name);
+        return id == INVALID_ITEM ? 0 : getTotalQuantity(id);
+    }
+
+    void searchItem(const string& name) const {
+        int quantity = getTotalQuantity(name);
+        if (quantity > 0)
+            cout << "Found: " << name << " (" << quantity << ")" << endl;
         else
             cout << "Item '" << name << "' not found." << endl;
     }
 
-    void displayTotalQuantity(string name) {
-        int totalQuantity = getTotalQuantity(root, name);
+    void displayInventory() const {
+        if (size() == 0) {
+            cout << "Inventory is empty." << endl;
+            return;
+        }
+        cout << "Inventory:" << endl;
+        forEachInRange(0, INVALID_ITEM - 1, [this](const GameItem& item) {
+            cout << registry.name(item.id) << " (" << item.quantity << ")" << endl;
+        });
+    }
+
+    void displayTotalQuantity(const string& name) const {
+        int totalQuantity = getTotalQuantity(name);
         if (totalQuantity > 0)
             cout << "Total quantity of " << name << ": " << totalQuantity << endl;
         else
             cout << "Item '" << name << "' not found in inventory." << endl;
     }
+
+private:
+    ItemRegistry& registry;
+    FlatInventory flat;
+    AVLTree tree;
+    int flatLimit;
+    bool useTree;
+
+    void moveToTree() {
+        auto insert = [this](const GameItem& item) { tree.addItem(item.id, item.quantity); };
+        flat.forEachInRange(0, INVALID_ITEM - 1, insert);
+        flat.clear();
+        useTree = true;
+    }
+
+    void moveToFlat() {
+        auto append = [this](const GameItem& item) { flat.addItem(item.id, item.quantity); };
+        tree.forEachInRange(tree.root, 0, INVALID_ITEM - 1, append);
+        tree.clear();
+        useTree = false;
+    }
+};
+
+typedef uint32_t PlayerId;
+
+// Inventory store shared between threads. Players are sharded by id; writers to a shard
+// are serialized by its mutex and publish a fresh immutable copy of the inventory, while
+// readers never lock: they announce the epoch they read in and load the current copy.
+// A replaced copy is freed only once every reader that could still see it has left
+// (epoch-based reclamation). Copy-on-write suits the small inventories most players have.
+class ConcurrentInventoryService {
+public:
+    static const int MAX_READERS = 64;
+
+    ConcurrentInventoryService(int shardCount = 16) : shards(shardCount), epoch(1) {
+        for (Shard& shard : shards)
+            shard.directory.store(new Directory());
+        for (ReaderSlot& slot : readers) {
+            slot.epoch.store(0);
+            slot.taken.store(false);
+        }
+    }
+
+    ~ConcurrentInventoryService() {
+        for (Shard& shard : shards) {
+            const Directory* directory = shard.directory.load();
+            for (const auto& entry : *directory) {
+                delete entry.second->items.load();
+                delete entry.second;
+            }
+            delete directory;
+            for (const Retired& r : shard.retired)
+                r.destroy(r.ptr);
+        }
+    }
+
+    ConcurrentInventoryService(const ConcurrentInventoryService&) = delete;
+    ConcurrentInventoryService& operator=(const ConcurrentInventoryService&) = delete;
+
+    // Each reading thread registers once and passes its id to read(); -1 when all slots are taken
+    int registerReader() {
+        for (int id = 0; id < MAX_READERS; ++id) {
+            bool expected = false;
+            if (!readers[id].taken.load(memory_order_relaxed) && readers[id].taken.compare_exchange_strong(expected, true))
+                return id;
+        }
+        cerr << "Error: Too many inventory reader threads." << endl;
+        return -1;
+    }
+
+    // Frees the reader's slot for another thread; call when the thread stops reading
+    void unregisterReader(int reader) {
+        if (reader >= 0 && reader < MAX_READERS)
+            readers[reader].taken.store(false);
+    }
+
+    void addPlayer(PlayerId player) {
+        Shard& shard = shardFor(player);
+        lock_guard<mutex> lock(shard.writeLock);
+        const Directory* old = shard.directory.load();
+        if (old->count(player))
+            return;
+
+        Directory* directory = new Directory(*old);
+        PlayerSlot* slot = new PlayerSlot();
+        slot->items.store(new ItemList());
+        (*directory)[player] = slot;
+        shard.directory.store(directory);
+        retire(shard, old, [](const void* p) { delete (const Directory*)p; });
+    }
+
+    // Runs read(const vector<GameItem>& items) on a consistent snapshot; false for unknown
+    // players or a reader id registerReader() did not hand out
+    template <class Read>
+    bool read(int reader, PlayerId player, Read read) {
+        if (reader < 0 || reader >= MAX_READERS)
+            return false;
+        ReaderSlot& slot = readers[reader];
+        slot.epoch.store(epoch.load());
+
+        const Directory* directory = shardFor(player).directory.load();
+        auto it = directory->find(player);
+        bool found = it != directory->end();
+        if (found)
+            read(*it->second->items.load());
+
+        slot.epoch.store(0, memory_order_release);
+        return found;
+    }
+
+    int getTotalQuantity(int reader, PlayerId player, ItemId id) {
+        int quantity = 0;
+        read(reader, player, [&](const ItemList& items) {
+            auto it = lower_bound(items.begin(), items.end(), id, [](const GameItem& item, ItemId key) { return item.id < key; });
+            if (it != items.end() && it->id == id)
+                quantity = it->quantity;
+        });
+        return quantity;
+    }
+
+    // All-or-nothing batch on one player's inventory (see Inventory::applyBatch)
+    bool applyBatch(PlayerId player, const vector<ItemDelta>& deltas) {
+        Shard& shard = shardFor(player);
+        lock_guard<mutex> lock(shard.writeLock);
+        PlayerSlot* slot = findSlot(shard, player);
+        ItemList* next = new ItemList();
+        if (!slot || !mergeItemDeltas(*slot->items.load(), deltas, *next)) {
+            delete next;
+            return false;
+        }
+        publish(shard, slot, next);
+        return true;
+    }
+
+    // Moves `gives` from player a to player b and `receives` back, all or nothing. The two
+    // shards are locked in a fixed order to avoid deadlock. Each inventory is always read
+    // consistently, but separate reads of a and b may straddle the trade.
+    bool trade(PlayerId a, PlayerId b, const vector<ItemDelta>& gives, const vector<ItemDelta>& receives) {
+        vector<ItemDelta> forA, forB;
+        for (const ItemDelta& d : gives) {
+            forA.push_back({d.id, -d.quantity});
+            forB.push_back({d.id, d.quantity});
+        }
+        for (const ItemDelta& d : receives) {
+            forA.push_back({d.id, d.quantity});
+            forB.push_back({d.id, -d.quantity});
+        }
+
+        Shard& shardA = shardFor(a);
+        Shard& shardB = shardFor(b);
+        Shard* first = &shardA < &shardB ? &shardA : &shardB;
+        Shard* second = &shardA < &shardB ? &shardB : &shardA;
+        unique_lock<mutex> firstLock(first->writeLock);
+        unique_lock<mutex> secondLock;
+        if (second != first)
+            secondLock = unique_lock<mutex>(second->writeLock);
+
+        PlayerSlot* slotA = findSlot(shardA, a);
+        PlayerSlot* slotB = findSlot(shardB, b);
+        if (!slotA || !slotB || slotA == slotB)
+            return false;
+        ItemList* nextA = new ItemList();
+        ItemList* nextB = new ItemList();
+        if (!mergeItemDeltas(*slotA->items.load(), forA, *nextA) || !mergeItemDeltas(*slotB->items.load(), forB, *nextB)) {
+            delete nextA;
+            delete nextB;
+            return false;
+        }
+        publish(shardA, slotA, nextA);
+        publish(shardB, slotB, nextB);
+        return true;
+    }
+
+private:
+    // Sorted by id, never modified once published. Writers on any thread allocate these and
+    // reclamation frees them, so they come from a pool with per-thread caches.
+    struct ItemList : vector<GameItem>, Pooled<ItemList, true, MEM_INVENTORY> {};
+
+    struct PlayerSlot : Pooled<PlayerSlot, false, MEM_INVENTORY> {
+        atomic<const ItemList*> items;
+    };
+
+    typedef unordered_map<PlayerId, PlayerSlot*> Directory;
+
+    struct Retired {
+        const void* ptr;
+        void (*destroy)(const void*);
+        uint64_t epoch;
+    };
+
+    struct Shard {
+        mutex writeLock;
+        atomic<const Directory*> directory;
+        vector<Retired> retired;
+    };
+
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch;   // epoch the reader entered in, 0 while not reading
+        atomic<bool> taken;       // handed out by registerReader()
+    };
+
+    vector<Shard> shards;
+    atomic<uint64_t> epoch;
+    ReaderSlot readers[MAX_READERS];
+
+    Shard& shardFor(PlayerId player) {
+        return shards[(player * 2654435761u) % shards.size()];
+    }
+
+    // Caller holds the shard's write lock
+    PlayerSlot* findSlot(Shard& shard, PlayerId player) {
+        const Directory* directory = shard.directory.load();
+        auto it = directory->find(player);
+        return it == directory->end() ? nullptr : it->second;
+    }
+
+    void publish(Shard& shard, PlayerSlot* slot, const ItemList* next) {
+        const ItemList* old = slot->items.exchange(next);
+        retire(shard, old, [](const void* p) { delete (const ItemList*)p; });
+    }
+
+    // Stamps the replaced object with the current epoch and advances it; the object is
+    // freed once every active reader entered in a later epoch
+    void retire(Shard& shard, const void* ptr, void (*destroy)(const void*)) {
+        shard.retired.push_back({ptr, destroy, epoch.fetch_add(1)});
+        if (shard.retired.size() < 32)
+            return;
+
+        uint64_t oldestActive = UINT64_MAX;
+        for (const ReaderSlot& slot : readers) {
+            uint64_t e = slot.epoch.load();
+            if (e != 0 && e < oldestActive)
+                oldestActive = e;
+        }
+
+        size_t kept = 0;
+        for (const Retired& r : shard.retired) {
+            if (r.epoch < oldestActive)
+                r.destroy(r.ptr);
+            else
+                shard.retired[kept++] = r;
+        }
+        shard.retired.resize(kept);
+    }
 };
 
 int main() {
-    AVLTree inventory;
+    // Item catalogue, interned once at load time
+    ItemRegistry items;
+    items.intern("Potion");
+    items.intern("Shield");
+    items.intern("Sword");
+
+    Inventory inventory(items);
 
     
     inventory.addItem("Sword", 3);
@@ -258,5 +847,84 @@ int main() {
     inventory.displayTotalQuantity("Potion");
     inventory.displayTotalQuantity("Sword");
 
+    cout << "Items from Potion to Shield:" << endl;
+    inventory.forEachInRange(items.find("Potion"), items.find("Shield"), [&](const GameItem& item) {
+        cout << items.name(item.id) << " (" << item.quantity << ")" << endl;
+    });
+
+    // Crafting: 3 potions and a shield become an enchanted shield, or nothing changes
+    ItemId potion = items.find("Potion");
+    ItemId shield = items.find("Shield");
+    ItemId sword = items.find("Sword");
+    ItemId enchantedShield = items.intern("Enchanted Shield");
+    vector<ItemDelta> craft = {{potion, -3}, {shield, -1}, {enchantedShield, 1}};
+    for (int attempt = 0; attempt < 3; ++attempt)
+        cout << (inventory.applyBatch(craft) ? "Crafted" : "Could not craft") << " Enchanted Shield" << endl;
+
+    // A stack that would pass INT_MAX fails the whole batch instead of wrapping
+    int swordsBefore = inventory.getTotalQuantity(sword);
+    bool overflowed = inventory.applyBatch({{sword, INT_MAX}, {potion, 1}});
+    cout << "Overflowing batch " << (overflowed ? "applied" : "rejected")
+         << (!overflowed && inventory.getTotalQuantity(sword) == swordsBefore ? "" : " (unexpected)") << endl;
+
+    // Trade a sword for two potions with another player
+    Inventory merchant(items);
+    merchant.addItem(potion, 10);
+    bool traded = inventory.trade(merchant, {{sword, 1}}, {{potion, 2}});
+    cout << (traded ? "Traded" : "Trade failed") << ": Sword for 2 Potions" << endl;
+    inventory.displayInventory();
+
+    // Shared store: one writer thread hands out potions while readers check stock
+    ConcurrentInventoryService service;
+    service.addPlayer(1);
+    service.addPlayer(2);
+    service.applyBatch(1, {{potion, 100}});
+
+    thread tradeWriter([&]() {
+        for (int i = 0; i < 100; ++i)
+            service.trade(1, 2, {{potion, 1}}, {});
+    });
+    vector<thread> readerThreads;
+    for (int t = 0; t < 3; ++t) {
+        readerThreads.emplace_back([&]() {
+            int reader = service.registerReader();
+            for (int i = 0; i < 1000; ++i) {
+                int held = 0;
+                service.read(reader, 1, [&](const vector<GameItem>& items) {
+                    for (const GameItem& item : items)
+                        held += item.quantity;
+                });
+                if (held < 0 || held > 100)
+                    cerr << "Inconsistent snapshot" << endl;
+            }
+            service.unregisterReader(reader);
+        });
+    }
+    tradeWriter.join();
+    for (thread& t : readerThreads)
+        t.join();
+
+    int reader = service.registerReader();
+    cout << "Player 2 potions after trades: " << service.getTotalQuantity(reader, 2, potion) << endl;
+    service.unregisterReader(reader);
+
+    // Checkpoint both inventories and read them back from the mapped save file
+    vector<SavedItem> saved;
+    SaveWriter writer;
+    inventory.exportSorted(saved);
+    writer.addPlayer({1, 0, 0, 0, 0, 0, saved.data(), (uint32_t)saved.size()});
+    vector<SavedItem> savedMerchant;
+    merchant.exportSorted(savedMerchant);
+    writer.addPlayer({2, 0, 0, 0, 0, 0, savedMerchant.data(), (uint32_t)savedMerchant.size()});
+
+    SaveReader save;
+    PlayerSaveData record;
+    if (writer.writeFile("inventories.sav") && save.open("inventories.sav") && save.findPlayer(1, record)) {
+        Inventory restored(items);
+        restored.loadSorted(record.items, record.itemCount);
+        cout << "Restored from save:" << endl;
+        restored.displayInventory();
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -5,6 +5,16 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include "save_game.h"
+#include "frame_arena.h"
+#include "memory_tracker.h"
+#include "asset_manager.h"
+#include "file_watcher.h"
 
 using namespace std;
 
@@ -12,6 +22,119 @@ const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 const int TILE_SIZE = 32;
 
+// Assets are named relative to the game directory. Release builds ship them in ASSET_PACK_PATH
+// (make -f packer.mk, then: packer assets.pak level_config.txt bgmusic.mp3 PressStart2P-Regular.ttf);
+// without the pack they are read as loose files.
+const char* const ASSET_PACK_PATH = "assets.pak";
+const char* const UI_FONT_PATH = "PressStart2P-Regular.ttf";
+const int UI_FONT_SIZE = 24;
+const double ASSET_FINISH_BUDGET_MICROS = 2000.0;   // main-thread texture/font work per frame
+const int CHUNK_TILES = 8;   // tile cache chunks are CHUNK_TILES x CHUNK_TILES tiles
+
+// Per-subsystem memory budgets (bytes) for the smallest deployment target; 0 is unbudgeted
+const size_t MEMORY_BUDGETS[MEM_TAG_COUNT] = {
+    0,                  // general
+    512 * 1024,         // level
+    16 * 1024 * 1024,   // audio
+    32 * 1024 * 1024,   // textures
+    0,                  // inventory
+    1024 * 1024,        // ai
+    1024 * 1024,        // frame
+};
+
+// SDL (and the mixer and font libraries on top of it) allocate through these, so their
+// memory is charged to the calling thread's MemoryScope. SDL gets the pointers malloc
+// returned, unchanged, and each block's size and tag are kept in a side table so a free
+// is credited back to the subsystem that allocated it. A block that crosses over between
+// malloc/free and SDL_malloc/SDL_free stays valid; at worst its bytes are not credited.
+struct SdlAlloc {
+    size_t size;
+    MemoryTag tag;
+};
+
+struct SdlAllocTable {
+    mutex lock;
+    unordered_map<void*, SdlAlloc> blocks;
+};
+
+// Never destroyed, so SDL can still free through it while statics are torn down
+SdlAllocTable& sdlAllocTable() {
+    static SdlAllocTable* table = new SdlAllocTable();
+    return *table;
+}
+
+void TrackSdlAlloc(void* p, size_t size, MemoryTag tag) {
+    SdlAllocTable& table = sdlAllocTable();
+    {
+        lock_guard<mutex> guard(table.lock);
+        table.blocks[p] = {size, tag};
+    }
+    MemoryTracker::instance().recordAlloc(tag, size);
+}
+
+void UntrackSdlAlloc(void* p) {
+    SdlAllocTable& table = sdlAllocTable();
+    SdlAlloc block;
+    {
+        lock_guard<mutex> guard(table.lock);
+        auto it = table.blocks.find(p);
+        if (it == table.blocks.end()) {
+            return;
+        }
+        block = it->second;
+        table.blocks.erase(it);
+    }
+    MemoryTracker::instance().recordFree(block.tag, block.size);
+}
+
+void* SDLCALL TrackedMalloc(size_t size) {
+    void* p = malloc(size);
+    if (p) {
+        TrackSdlAlloc(p, size, MemoryScope::current());
+    }
+    return p;
+}
+
+void* SDLCALL TrackedCalloc(size_t count, size_t size) {
+    void* p = calloc(count, size);
+    if (p) {
+        TrackSdlAlloc(p, count * size, MemoryScope::current());
+    }
+    return p;
+}
+
+// A resized block keeps the tag it was first allocated under. The table stays locked
+// across realloc so another thread cannot be handed the old address in between.
+void* SDLCALL TrackedRealloc(void* p, size_t size) {
+    SdlAlloc old = {0, MemoryScope::current()};
+    void* resized;
+    {
+        SdlAllocTable& table = sdlAllocTable();
+        lock_guard<mutex> guard(table.lock);
+        resized = realloc(p, size ? size : 1);   // realloc(p, 0) may free p and return null
+        if (!resized) {
+            return nullptr;
+        }
+        auto it = p ? table.blocks.find(p) : table.blocks.end();
+        if (it != table.blocks.end()) {
+            old = it->second;
+            table.blocks.erase(it);
+        }
+        table.blocks[resized] = {size, old.tag};
+    }
+    MemoryTracker::instance().recordFree(old.tag, old.size);
+    MemoryTracker::instance().recordAlloc(old.tag, size);
+    return resized;
+}
+
+void SDLCALL TrackedFree(void* p) {
+    if (!p) {
+        return;
+    }
+    UntrackSdlAlloc(p);
+    free(p);
+}
+
 class Player {
 private:
     int x, y, SPEED, JUMP_VELOCITY;
@@ -23,6 +146,129 @@ public:
     friend class GameEngine;
 };
 
+// Decides which AI agents think on each frame. An agent's tick interval comes from its
+// distance to the viewer, shortened by its importance: agents near the player tick every
+// frame, the rest of the screen every other frame, and off-screen agents every 8 or 32.
+// Agents wait in a timing wheel slot for the frame they are next due, and are added with
+// a phase of id % interval, so a crowd with the same interval is spread evenly over frames
+// and costs nothing on the frames in between.
+//
+// Due agents are ticked until the frame's time budget is spent; the remainder is deferred
+// and ticked first on the next frame. The tick callback gets the number of frames since the
+// agent last ticked so it can scale its movement.
+class AIScheduler {
+public:
+    static const int WHEEL_SIZE = 32;   // longest interval, in frames
+
+    typedef vector<int, TrackedAllocator<int, MEM_AI>> AgentIds;
+
+    explicit AIScheduler(double frameBudgetMicros)
+        : wheel(WHEEL_SIZE), frame(0), budgetMicros(frameBudgetMicros), ticked(0), deferredCount(0) {}
+
+    // importance 0 is a normal agent; each step halves its interval. The first tick comes
+    // within one interval, at a phase of id % interval, so agents spawned together are spread
+    // over the frames of their interval.
+    int addAgent(int x, int y, int importance, int viewerX, int viewerY) {
+        int id = agents.size();
+        agents.push_back({x, y, importance, frame});
+        wheel[(frame + id % intervalFor(agents.back(), viewerX, viewerY)) % WHEEL_SIZE].push_back(id);
+        return id;
+    }
+
+    void moveAgent(int id, int x, int y) {
+        agents[id].x = x;
+        agents[id].y = y;
+    }
+
+    void clear() {
+        agents.clear();
+        for (AgentIds& slot : wheel) {
+            slot.clear();
+        }
+        deferred.clear();
+    }
+
+    template <class TickFn>
+    void runFrame(int viewerX, int viewerY, TickFn tick) {
+        auto start = chrono::steady_clock::now();
+        AgentIds& slot = wheel[frame % WHEEL_SIZE];
+        due.swap(deferred);
+        due.insert(due.end(), slot.begin(), slot.end());
+        slot.clear();
+
+        ticked = 0;
+        size_t i = 0;
+        for (; i < due.size(); ++i) {
+            if (ticked > 0 && chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() > budgetMicros) {
+                break;
+            }
+            int id = due[i];
+            Agent& agent = agents[id];
+            tick(id, (int)(frame - agent.lastTick));
+            agent.lastTick = frame;
+            wheel[(frame + intervalFor(agent, viewerX, viewerY)) % WHEEL_SIZE].push_back(id);
+            ++ticked;
+        }
+
+        deferred.assign(due.begin() + i, due.end());
+        deferredCount = deferred.size();
+        due.clear();
+        ++frame;
+    }
+
+    int tickedLastFrame() const {
+        return ticked;
+    }
+
+    int deferredLastFrame() const {
+        return deferredCount;
+    }
+
+private:
+    struct Agent {
+        int x, y;
+        int importance;
+        uint32_t lastTick;
+    };
+
+    int intervalFor(const Agent& agent, int viewerX, int viewerY) const {
+        long long dx = agent.x - viewerX;
+        long long dy = agent.y - viewerY;
+        long long distance2 = dx * dx + dy * dy;
+        const long long closeRange = SCREEN_WIDTH / 4;
+        const long long onScreen = SCREEN_WIDTH;
+        const long long offScreen = SCREEN_WIDTH * 2;
+
+        int interval;
+        if (distance2 < closeRange * closeRange) {
+            interval = 1;
+        } else if (distance2 < onScreen * onScreen) {
+            interval = 2;
+        } else if (distance2 < offScreen * offScreen) {
+            interval = 8;
+        } else {
+            interval = WHEEL_SIZE;
+        }
+        return max(1, interval >> agent.importance);
+    }
+
+    vector<Agent, TrackedAllocator<Agent, MEM_AI>> agents;
+    vector<AgentIds, TrackedAllocator<AgentIds, MEM_AI>> wheel;
+    AgentIds deferred;
+    AgentIds due;
+    uint32_t frame;
+    double budgetMicros;
+    int ticked;
+    int deferredCount;
+};
+
+// Patrolling NPC, spawned from tile 3 in the level file
+struct Npc {
+    int x, y;
+    int direction;   // -1 left, 1 right
+    int aiId;
+};
+
 class GameEngine {
 public:
     GameEngine();
@@ -34,10 +280,15 @@ public:
     void Update();
     void RenderPauseMenu();
     int checkCollision(int choice = 0);
+    bool SaveGame(const string& saveFile);
+    bool LoadGame(const string& saveFile);
+    bool RunHeadless(int frames);
 
 private:
     SDL_Window* window;
     SDL_Renderer* renderer;
+    bool initialized;   // SDL_Init succeeded, so SDL and its libraries need shutting down
+    bool shutDown;      // Shutdown() has run; the destructor calls it again
     Player py;
     bool isRunning;
     bool left;
@@ -47,35 +298,93 @@ private:
     int velocityY;
     bool isPaused;
 
-    vector<vector<int>> levelData;
-
-    Mix_Music* backgroundMusic;
+    LevelRows levelData;
+    LevelRows levelSource;   // the level as loaded, NPC spawn tiles included; reloads diff against it
+    int levelId;
+
+    // Tile rects by colour, cached per chunk and rebuilt only when a tile in the chunk changes
+    typedef vector<SDL_Rect, TrackedAllocator<SDL_Rect, MEM_LEVEL>> RectList;
+    struct TileChunk {
+        RectList red;
+        RectList blue;
+        bool dirty;
+    };
+    vector<TileChunk> tileChunks;
+    size_t chunkColumns;
+
+    vector<Npc, TrackedAllocator<Npc, MEM_AI>> npcs;
+    AIScheduler aiScheduler;
+
+    AssetPack assetPack;   // outlives assets, which point into its mapping
+    AssetManager assets;
+    AssetHandle uiFont;
+    AssetHandle levelAsset;
+    AssetHandle musicAsset;
+    bool levelLoaded;
+    bool levelApplied;      // levelVersion has been applied, even if it was empty
+    uint32_t levelVersion;
+    uint32_t musicVersion;
+    FileWatcher watcher;   // loose assets only; packed builds do not hot reload
+
+    Mix_Music* backgroundMusic;   // owned by musicAsset
     bool musicPlaying;
 
     bool showPlayButton;
     bool enterPressed;
     bool gameStarted;
 
-    void LoadLevelConfiguration(const string& configFile);
+    bool showMemoryOverlay;
+    uint32_t budgetWarnings;   // one bit per tag already reported over budget
+
+    void ApplyLevel(const LevelRows& rows);
+    void ReloadLevel(const LevelRows& rows);
+    void SpawnNpcs();
+    void ResetTileChunks();
+    void RebuildTileChunk(size_t index);
+    void ReloadChangedAssets();
+    void PollAssets();
     void RenderScene();
+    void RenderMemoryOverlay();
+    void EndFrame();
     void handleInput();
+    void UpdateAI();
+    void TickNpc(Npc& npc, int elapsedFrames);
+    bool IsSolidTile(int x, int y) const;
 };
 
 GameEngine::GameEngine()
     : window(nullptr),
       renderer(nullptr),
+      initialized(false),
+      shutDown(false),
       isRunning(false),
       left(false),
       right(false),
       jump(false),
       isJumping(false),
       velocityY(0),
+      levelId(0),
+      chunkColumns(0),
+      aiScheduler(2000.0),
+      levelLoaded(false),
+      levelApplied(false),
+      levelVersion(0),
+      musicVersion(0),
       backgroundMusic(nullptr),
       musicPlaying(false),
       showPlayButton(true),
       enterPressed(false),
       gameStarted(false),
-      isPaused(false) {}
+      isPaused(false),
+      showMemoryOverlay(false),
+      budgetWarnings(0) {
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        MemoryTracker::instance().setBudget((MemoryTag)t, MEMORY_BUDGETS[t]);
+    }
+    if (assetPack.open(ASSET_PACK_PATH)) {
+        assets.setPack(&assetPack);
+    }
+}
 
 GameEngine::~GameEngine() {
     Shutdown();
@@ -87,6 +396,7 @@ void GameEngine::Initialize(const char* title, int width, int height) {
         cerr << "SDL initialization error: " << SDL_GetError() << endl;
         return;
     }
+    initialized = true;
 
     window = SDL_CreateWindow(title, 50, 50, width, height, SDL_WINDOW_SHOWN);
     if (!window) {
@@ -100,9 +410,12 @@ void GameEngine::Initialize(const char* title, int width, int height) {
         return;
     }
 
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
-        cerr << "SDL_mixer initialization error: " << Mix_GetError() << endl;
-        return;
+    {
+        MemoryScope audioScope(MEM_AUDIO);
+        if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
+            cerr << "SDL_mixer initialization error: " << Mix_GetError() << endl;
+            return;
+        }
     }
 
     if (TTF_Init() < 0) {
@@ -110,11 +423,21 @@ void GameEngine::Initialize(const char* title, int width, int height) {
         return;
     }
 
-    LoadLevelConfiguration("level_config.txt");
+    if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) == 0) {
+        cerr << "SDL_image initialization error: " << IMG_GetError() << endl;
+    }
 
-    backgroundMusic = Mix_LoadMUS("bgmusic.mp3");
-    if (!backgroundMusic) {
-        cerr << "Failed to load music: " << Mix_GetError() << endl;
+    // The title screen only needs the font; the level and music stream in behind it
+    assets.setRenderer(renderer);
+    uiFont = assets.load(UI_FONT_PATH, ASSET_FONT, ASSET_PRIORITY_HIGH, UI_FONT_SIZE);
+    levelAsset = assets.load("level_config.txt", ASSET_LEVEL, ASSET_PRIORITY_NORMAL);
+    musicAsset = assets.load("bgmusic.mp3", ASSET_MUSIC, ASSET_PRIORITY_NORMAL);
+
+    // Edits to loose assets (e.g. saving from the level editor) are picked up while running
+    if (!assetPack.isOpen()) {
+        watcher.watch("level_config.txt");
+        watcher.watch("bgmusic.mp3");
+        watcher.watch(UI_FONT_PATH);
     }
 
     isRunning = true;
@@ -124,30 +447,120 @@ void GameEngine::Run() {
     cout << "Run";
     while (isRunning) {
         handleInput();
-        if (!showPlayButton) {
+        ReloadChangedAssets();
+        assets.update(ASSET_FINISH_BUDGET_MICROS);
+        PollAssets();
+        if (!showPlayButton && levelLoaded) {
             Update();
+            UpdateAI();
         }
         RenderScene();
+        EndFrame();
+    }
+}
+
+// Simulates the game without a window for CI: loads the level and runs the player and AI
+// updates for the given number of frames. Returns false if any subsystem exceeded its budget.
+bool GameEngine::RunHeadless(int frames) {
+    levelAsset = assets.load("level_config.txt", ASSET_LEVEL, ASSET_PRIORITY_HIGH);
+    if (!assets.wait(levelAsset) || levelAsset.level()->empty()) {
+        return false;
+    }
+    ApplyLevel(*levelAsset.level());
+    showPlayButton = false;
+    gameStarted = true;
+    for (int frame = 0; frame < frames; ++frame) {
+        Update();
+        UpdateAI();
+        EndFrame();
+    }
+    return !MemoryTracker::instance().anyOverBudget();
+}
+
+// Picks up assets that finished loading or reloading since the last frame
+void GameEngine::PollAssets() {
+    // Each version is applied once; an empty level stays unloaded until the next reload
+    if (levelAsset.ready() && (!levelApplied || levelAsset.version() != levelVersion)) {
+        if (!levelLoaded) {
+            ApplyLevel(*levelAsset.level());
+        } else {
+            ReloadLevel(*levelAsset.level());
+        }
+        levelLoaded = !levelData.empty();
+        levelApplied = true;
+        levelVersion = levelAsset.version();
+    }
+
+    // A reload frees the old music, which stops it; keep playing with the new track
+    if (musicAsset.ready() && (!backgroundMusic || musicAsset.version() != musicVersion)) {
+        backgroundMusic = musicAsset.music();
+        musicVersion = musicAsset.version();
+        if (musicPlaying) {
+            Mix_PlayMusic(backgroundMusic, -1);
+        }
+    }
+}
+
+void GameEngine::ReloadChangedAssets() {
+    vector<string> changed;
+    watcher.poll(changed);
+    for (const string& path : changed) {
+        if (assets.reload(path) > 0) {
+            cout << "Reloading " << path << endl;
+        }
+    }
+}
+
+// Releases the frame's scratch memory, closes the frame's allocation counts, and warns
+// once for each subsystem that has gone over its budget
+void GameEngine::EndFrame() {
+    FrameArena::forThread().reset();
+    MemoryTracker& tracker = MemoryTracker::instance();
+    tracker.endFrame();
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        if (tracker.overBudget((MemoryTag)t) && !(budgetWarnings & (1u << t))) {
+            budgetWarnings |= 1u << t;
+            MemoryTracker::TagStats s = tracker.stats((MemoryTag)t);
+            cerr << "Warning: " << memoryTagName((MemoryTag)t) << " memory over budget (peak " << s.peak / 1024
+                 << " KB, budget " << s.budget / 1024 << " KB)" << endl;
+        }
     }
 }
 
 void GameEngine::Shutdown() {
+    if (shutDown) {
+        return;
+    }
+    shutDown = true;
     cout << "Shutdown";
-    if (backgroundMusic) {
-        Mix_FreeMusic(backgroundMusic);
+    // Assets hold SDL objects, so they go before the renderer and the libraries
+    if (initialized) {
+        Mix_HaltMusic();
     }
+    backgroundMusic = nullptr;
+    uiFont = AssetHandle();
+    levelAsset = AssetHandle();
+    musicAsset = AssetHandle();
+    assets.shutdown();
 
     if (renderer) {
         SDL_DestroyRenderer(renderer);
+        renderer = nullptr;
     }
 
     if (window) {
         SDL_DestroyWindow(window);
+        window = nullptr;
     }
 
-    Mix_CloseAudio();
-    TTF_Quit();
-    SDL_Quit();
+    // Headless runs never initialise SDL; the mixer, font and image libraries tolerate a
+    // quit after a failed init of their own, but not without SDL
+    if (initialized) {
+        Mix_CloseAudio();
+        IMG_Quit();
+        TTF_Quit();
+        SDL_Quit();
+    }
 }
 
 int GameEngine::checkCollision(int choice) {
@@ -225,7 +638,7 @@ void GameEngine::Update() {
         isJumping = true;
         velocityY -= py.JUMP_VELOCITY;
 
-        if (!musicPlaying) {
+        if (!musicPlaying && backgroundMusic) {
             Mix_PlayMusic(backgroundMusic, -1);
             musicPlaying = true;
         }
@@ -241,34 +654,52 @@ void GameEngine::Update() {
 
     if (py.y + TILE_SIZE > SCREEN_HEIGHT) {
         Mix_HaltMusic();
-        backgroundMusic = Mix_LoadMUS("bgmusic.mp3");
-        if (!backgroundMusic) {
-            cerr << "Failed to load another music: " << Mix_GetError() << endl;
+        if (backgroundMusic) {
+            Mix_PlayMusic(backgroundMusic, -1);   // restart the track; it is already loaded
         }
-        Mix_PlayMusic(backgroundMusic, -1);
     }
 }
 
-void GameEngine::LoadLevelConfiguration(const string& configFile) {
-    ifstream inFile(configFile);
-    if (!inFile.is_open()) {
-        cerr << "Error: Could not open file for reading." << endl;
-        return;
+bool GameEngine::IsSolidTile(int x, int y) const {
+    if (y < 0 || y >= (int)levelData.size() || x < 0 || x >= (int)levelData[y].size()) {
+        return true;
     }
+    return levelData[y][x] == 1;
+}
 
-    levelData.clear();
-    int tileType;
-    string line;
-    while (getline(inFile, line, '\n')) {
-        vector<int> tileRow;
-        istringstream ss(line);
-        while (ss >> tileType) {
-            tileRow.push_back(tileType);
+// NPCs walk along their row and turn at walls and ledges; a throttled NPC moves
+// as far as it would have over the frames it skipped
+void GameEngine::TickNpc(Npc& npc, int elapsedFrames) {
+    const int NPC_SPEED = 1;
+    for (int step = 0; step < elapsedFrames * NPC_SPEED; ++step) {
+        int nextX = npc.x + npc.direction;
+        int ahead = nextX < 0 ? -1 : (npc.direction > 0 ? nextX + TILE_SIZE - 1 : nextX) / TILE_SIZE;
+        int row = npc.y / TILE_SIZE;
+        if (IsSolidTile(ahead, row) || !IsSolidTile(ahead, row + 1)) {
+            npc.direction = -npc.direction;
+        } else {
+            npc.x += npc.direction;
         }
-        levelData.push_back(tileRow);
     }
+    aiScheduler.moveAgent(npc.aiId, npc.x, npc.y);
+}
+
+// Scheduler ids are handed out in spawn order, so they index npcs directly
+void GameEngine::UpdateAI() {
+    aiScheduler.runFrame(py.x, py.y, [this](int id, int elapsedFrames) {
+        TickNpc(npcs[id], elapsedFrames);
+    });
+}
 
-    inFile.close();
+// Installs a parsed level and spawns its NPCs
+void GameEngine::ApplyLevel(const LevelRows& rows) {
+    levelSource = rows;
+    levelData = rows;
+    for (LevelRow& row : levelData) {
+        replace(row.begin(), row.end(), 3, 0);   // spawn tiles are empty once the NPC is out
+    }
+    SpawnNpcs();
+    ResetTileChunks();
 
     for (const auto& row : levelData) {
         for (const auto& tile : row) {
@@ -278,15 +709,130 @@ void GameEngine::LoadLevelConfiguration(const string& configFile) {
     }
 }
 
+// Applies an edited level in place: only tiles that differ from the previous version are
+// written and only their chunks are rebuilt. NPCs read the live tile map on every tick, so
+// they path around the new layout on their next tick; they are only respawned when spawn
+// tiles moved. A level whose dimensions changed is applied from scratch.
+void GameEngine::ReloadLevel(const LevelRows& rows) {
+    bool sameShape = rows.size() == levelSource.size();
+    for (size_t y = 0; sameShape && y < rows.size(); ++y) {
+        sameShape = rows[y].size() == levelSource[y].size();
+    }
+    if (!sameShape) {
+        ApplyLevel(rows);
+        cout << "Level reloaded (new dimensions)" << endl;
+        return;
+    }
+
+    int changedTiles = 0;
+    bool spawnsMoved = false;
+    for (size_t y = 0; y < rows.size(); ++y) {
+        for (size_t x = 0; x < rows[y].size(); ++x) {
+            int tile = rows[y][x];
+            if (tile == levelSource[y][x]) {
+                continue;
+            }
+            spawnsMoved = spawnsMoved || tile == 3 || levelSource[y][x] == 3;
+            levelData[y][x] = tile == 3 ? 0 : tile;
+            tileChunks[(y / CHUNK_TILES) * chunkColumns + x / CHUNK_TILES].dirty = true;
+            ++changedTiles;
+        }
+    }
+    levelSource = rows;
+    if (spawnsMoved) {
+        SpawnNpcs();
+    }
+    cout << "Level reloaded: " << changedTiles << " tiles changed" << endl;
+}
+
+// NPCs start on the spawn tiles (3) of the loaded level
+void GameEngine::SpawnNpcs() {
+    npcs.clear();
+    aiScheduler.clear();
+    for (size_t y = 0; y < levelSource.size(); ++y) {
+        for (size_t x = 0; x < levelSource[y].size(); ++x) {
+            if (levelSource[y][x] == 3) {
+                int spawnX = x * TILE_SIZE;
+                int spawnY = y * TILE_SIZE;
+                npcs.push_back({spawnX, spawnY, 1, aiScheduler.addAgent(spawnX, spawnY, 0, py.x, py.y)});
+            }
+        }
+    }
+}
+
+void GameEngine::ResetTileChunks() {
+    size_t width = 0;
+    for (const LevelRow& row : levelData) {
+        width = max(width, row.size());
+    }
+    chunkColumns = (width + CHUNK_TILES - 1) / CHUNK_TILES;
+    size_t chunkRows = (levelData.size() + CHUNK_TILES - 1) / CHUNK_TILES;
+    tileChunks.clear();
+    tileChunks.resize(chunkColumns * chunkRows);
+    for (TileChunk& chunk : tileChunks) {
+        chunk.dirty = true;
+    }
+}
+
+void GameEngine::RebuildTileChunk(size_t index) {
+    TileChunk& chunk = tileChunks[index];
+    chunk.red.clear();
+    chunk.blue.clear();
+    size_t firstX = (index % chunkColumns) * CHUNK_TILES;
+    size_t firstY = (index / chunkColumns) * CHUNK_TILES;
+    for (size_t y = firstY; y < min(firstY + CHUNK_TILES, levelData.size()); ++y) {
+        for (size_t x = firstX; x < min(firstX + CHUNK_TILES, levelData[y].size()); ++x) {
+            SDL_Rect tileRect = {static_cast<int>(x * TILE_SIZE), static_cast<int>(y * TILE_SIZE), TILE_SIZE, TILE_SIZE};
+
+            switch (levelData[y][x]) {
+                case 1:
+                    chunk.red.push_back(tileRect);
+                    break;
+                case 2:
+                    chunk.blue.push_back(tileRect);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    chunk.dirty = false;
+}
+
+bool GameEngine::SaveGame(const string& saveFile) {
+    int velocityX = left ? -py.SPEED : (right ? py.SPEED : 0);
+    SaveWriter writer;
+    writer.addPlayer({0, (uint32_t)levelId, py.x, py.y, velocityX, velocityY, nullptr, 0});
+    if (!writer.writeFile(saveFile))
+        return false;
+    cout << "Game saved to " << saveFile << endl;
+    return true;
+}
+
+bool GameEngine::LoadGame(const string& saveFile) {
+    SaveReader save;
+    PlayerSaveData player;
+    if (!save.open(saveFile) || !save.findPlayer(0, player)) {
+        cerr << "Error: No saved player in " << saveFile << endl;
+        return false;
+    }
+
+    levelId = player.levelId;
+    py.x = player.x;
+    py.y = player.y;
+    velocityY = player.velocityY;
+    isJumping = velocityY != 0;
+    cout << "Game loaded from " << saveFile << endl;
+    return true;
+}
+
 void GameEngine::RenderPauseMenu() {
     SDL_Rect menuRect = {SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2};
     SDL_SetRenderDrawColor(renderer, 128, 128, 128, 255);
     SDL_RenderFillRect(renderer, &menuRect);
 
-    TTF_Font* resumeFont = TTF_OpenFont("C:\\Users\\ASUS\\Downloads\\Press_Start_2P\\PressStart2P-Regular.ttf", 24);
-    if (!resumeFont) {
-        cerr << "Failed to load font: " << TTF_GetError() << endl;
-    } else {
+    TTF_Font* resumeFont = uiFont.font();
+    if (resumeFont) {
         SDL_Color resumeTextColor = {255, 255, 255, 255};
         SDL_Surface* resumeTextSurface = TTF_RenderText_Solid(resumeFont, "Resume", resumeTextColor);
         if (resumeTextSurface) {
@@ -304,14 +850,10 @@ void GameEngine::RenderPauseMenu() {
         } else {
             cerr << "Failed to render text surface: " << TTF_GetError() << endl;
         }
-
-        TTF_CloseFont(resumeFont);
     }
 
-    TTF_Font* startFont = TTF_OpenFont("C:\\Users\\ASUS\\Downloads\\Press_Start_2P\\PressStart2P-Regular.ttf", 24);
-    if (!startFont) {
-        cerr << "Failed to load font: " << TTF_GetError() << endl;
-    } else {
+    TTF_Font* startFont = uiFont.font();
+    if (startFont) {
         SDL_Color startTextColor = {255, 255, 255, 255};
         SDL_Surface* startTextSurface = TTF_RenderText_Solid(startFont, "Start New Game (S)", startTextColor);
         if (startTextSurface) {
@@ -329,14 +871,10 @@ void GameEngine::RenderPauseMenu() {
         } else {
             cerr << "Failed to render text surface: " << TTF_GetError() << endl;
         }
-
-        TTF_CloseFont(startFont);
     }
 
-    TTF_Font* exitFont = TTF_OpenFont("C:\\Users\\ASUS\\Downloads\\Press_Start_2P\\PressStart2P-Regular.ttf", 24);
-    if (!exitFont) {
-        cerr << "Failed to load font: " << TTF_GetError() << endl;
-    } else {
+    TTF_Font* exitFont = uiFont.font();
+    if (exitFont) {
         SDL_Color exitTextColor = {255, 255, 255, 255};
         SDL_Surface* exitTextSurface = TTF_RenderText_Solid(exitFont, "Exit (E)", exitTextColor);
         if (exitTextSurface) {
@@ -354,8 +892,6 @@ void GameEngine::RenderPauseMenu() {
         } else {
             cerr << "Failed to render text surface: " << TTF_GetError() << endl;
         }
-
-        TTF_CloseFont(exitFont);
     }
 }
 
@@ -410,6 +946,20 @@ void GameEngine::handleInput() {
                         isPaused = false;
                     }
                     break;
+                case SDLK_F5:
+                    if (gameStarted) {
+                        SaveGame("savegame.sav");
+                    }
+                    break;
+                case SDLK_F9:
+                    if (gameStarted) {
+                        LoadGame("savegame.sav");
+                    }
+                    break;
+                case SDLK_F3:
+                    showMemoryOverlay = !showMemoryOverlay;
+                    MemoryTracker::instance().dump(cout);
+                    break;
                 case SDLK_ESCAPE:
                     if (!gameStarted) {
                         isRunning = false;
@@ -440,6 +990,7 @@ void GameEngine::handleInput() {
 
 
 void GameEngine::RenderScene() {
+    MemoryScope textureScope(MEM_TEXTURES);
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderClear(renderer);
 
@@ -448,10 +999,8 @@ void GameEngine::RenderScene() {
         SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
         SDL_RenderFillRect(renderer, &playButtonRect);
 
-        TTF_Font* font = TTF_OpenFont("C:\\Users\\ASUS\\Downloads\\Press_Start_2P\\PressStart2P-Regular.ttf", 24);
-        if (!font) {
-            cerr << "Failed to load font: " << TTF_GetError() << endl;
-        } else {
+        TTF_Font* font = uiFont.font();   // null while it is still loading
+        if (font) {
             SDL_Color textColor = {255, 255, 255, 255};
             SDL_Surface* textSurface = TTF_RenderText_Solid(font, "Start", textColor);
             if (textSurface) {
@@ -469,18 +1018,14 @@ void GameEngine::RenderScene() {
             } else {
                 cerr << "Failed to render text surface: " << TTF_GetError() << endl;
             }
-
-            TTF_CloseFont(font);
         }
 
         SDL_Rect exitButtonRect = {SCREEN_WIDTH / 2 - 50, SCREEN_HEIGHT / 2 + 30, 100, 50};
         SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
         SDL_RenderFillRect(renderer, &exitButtonRect);
 
-        TTF_Font* exitFont = TTF_OpenFont("C:\\Users\\ASUS\\Downloads\\Press_Start_2P\\PressStart2P-Regular.ttf", 24);
-        if (!exitFont) {
-            cerr << "Failed to load font: " << TTF_GetError() << endl;
-        } else {
+        TTF_Font* exitFont = uiFont.font();
+        if (exitFont) {
             SDL_Color exitTextColor = {255, 255, 255, 255};
             SDL_Surface* exitTextSurface = TTF_RenderText_Solid(exitFont, "Exit", exitTextColor);
             if (exitTextSurface) {
@@ -498,32 +1043,38 @@ void GameEngine::RenderScene() {
             } else {
                 cerr << "Failed to render text surface: " << TTF_GetError() << endl;
             }
-
-            TTF_CloseFont(exitFont);
         }
     } else {
-        for (size_t y = 0; y < levelData.size(); ++y) {
-            for (size_t x = 0; x < levelData[y].size(); ++x) {
-                SDL_Rect tileRect = {static_cast<int>(x * TILE_SIZE), static_cast<int>(y * TILE_SIZE), TILE_SIZE, TILE_SIZE};
-
-                switch (levelData[y][x]) {
-                    case 0:
-                        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-                        SDL_RenderFillRect(renderer, &tileRect);
-                        break;
-                    case 1:
-                        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-                        SDL_RenderFillRect(renderer, &tileRect);
-                        break;
-                    case 2:
-                        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-                        SDL_RenderFillRect(renderer, &tileRect);
-                        break;
-                    default:
-                        break;
-                }
+        // Gather the cached chunk rects by colour in frame scratch memory and draw each colour
+        // in one call; only chunks whose tiles changed are rebuilt. Empty tiles (0) are the
+        // clear colour already.
+        size_t redCount = 0;
+        size_t blueCount = 0;
+        for (size_t i = 0; i < tileChunks.size(); ++i) {
+            if (tileChunks[i].dirty) {
+                RebuildTileChunk(i);
             }
+            redCount += tileChunks[i].red.size();
+            blueCount += tileChunks[i].blue.size();
         }
+        FrameVector<SDL_Rect> redTiles;
+        FrameVector<SDL_Rect> blueTiles;
+        redTiles.reserve(redCount);
+        blueTiles.reserve(blueCount);
+        for (const TileChunk& chunk : tileChunks) {
+            redTiles.insert(redTiles.end(), chunk.red.begin(), chunk.red.end());
+            blueTiles.insert(blueTiles.end(), chunk.blue.begin(), chunk.blue.end());
+        }
+        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+        SDL_RenderFillRects(renderer, redTiles.data(), redTiles.size());
+        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
+        SDL_RenderFillRects(renderer, blueTiles.data(), blueTiles.size());
+        SDL_SetRenderDrawColor(renderer, 0, 160, 0, 255);
+        for (const Npc& npc : npcs) {
+            SDL_Rect npcRect = {npc.x, npc.y, TILE_SIZE, TILE_SIZE};
+            SDL_RenderFillRect(renderer, &npcRect);
+        }
+
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
         SDL_Rect PlayerRect = {py.x, py.y, TILE_SIZE, TILE_SIZE};
         SDL_RenderFillRect(renderer, &PlayerRect);
@@ -532,16 +1083,82 @@ void GameEngine::RenderScene() {
     if (isPaused) {
         RenderPauseMenu();
     }
+    if (showMemoryOverlay) {
+        RenderMemoryOverlay();
+    }
 
     SDL_RenderPresent(renderer);
     SDL_Delay(8);
 }
 
+// Debug overlay (F3): a bar per budgeted subsystem filled to its current use, with a tick
+// at its peak. Bars turn red once the subsystem has exceeded its budget.
+void GameEngine::RenderMemoryOverlay() {
+    const int BAR_WIDTH = 200;
+    const int BAR_HEIGHT = 8;
+    MemoryTracker& tracker = MemoryTracker::instance();
+    int row = 0;
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        MemoryTracker::TagStats s = tracker.stats((MemoryTag)t);
+        if (s.budget == 0) {
+            continue;
+        }
+        int y = 10 + row++ * (BAR_HEIGHT + 4);
+        int used = (int)(BAR_WIDTH * min(1.0, (double)s.current / s.budget));
+        int peak = (int)(BAR_WIDTH * min(1.0, (double)s.peak / s.budget));
+
+        SDL_Rect background = {10, y, BAR_WIDTH, BAR_HEIGHT};
+        SDL_SetRenderDrawColor(renderer, 64, 64, 64, 255);
+        SDL_RenderFillRect(renderer, &background);
+
+        SDL_Rect fill = {10, y, used, BAR_HEIGHT};
+        if (tracker.overBudget((MemoryTag)t)) {
+            SDL_SetRenderDrawColor(renderer, 220, 0, 0, 255);
+        } else {
+            SDL_SetRenderDrawColor(renderer, 0, 200, 0, 255);
+        }
+        SDL_RenderFillRect(renderer, &fill);
+
+        SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+        SDL_RenderDrawLine(renderer, 10 + peak, y, 10 + peak, y + BAR_HEIGHT - 1);
+    }
+}
+
+// Usage: main_engine [--headless <frames>] [--memory-report <path>]
+// Headless runs exit with 1 when a memory budget was exceeded and 2 when the run failed.
 int main(int argc, char** argv) {
+    SDL_SetMemoryFunctions(TrackedMalloc, TrackedCalloc, TrackedRealloc, TrackedFree);
+
+    int headlessFrames = 0;
+    string memoryReport;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--headless" && i + 1 < argc) {
+            headlessFrames = atoi(argv[++i]);
+        } else if (arg == "--memory-report" && i + 1 < argc) {
+            memoryReport = argv[++i];
+        }
+    }
+
     GameEngine game;
+    if (headlessFrames > 0) {
+        bool withinBudget = game.RunHeadless(headlessFrames);
+        MemoryTracker::instance().dump(cout);
+        if (!memoryReport.empty() && !MemoryTracker::instance().writeReport(memoryReport)) {
+            return 2;
+        }
+        if (MemoryTracker::instance().anyOverBudget()) {
+            return 1;
+        }
+        return withinBudget ? 0 : 2;
+    }
+
     game.Initialize("Game Engine", SCREEN_WIDTH, SCREEN_HEIGHT);
     game.Run();
     game.Shutdown();
+    if (!memoryReport.empty()) {
+        MemoryTracker::instance().writeReport(memoryReport);
+    }
     return 0;
 }
 
@@ -0,0 +1,216 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Memory accounting by subsystem. Allocators report bytes against a tag; the tracker keeps
+// current and peak bytes per tag, allocation counts per frame, and optional budgets. A tag
+// is over budget once its peak has exceeded the budget, so a brief spike still fails a run.
+// Counters are atomics and may be updated from any thread.
+
+enum MemoryTag : uint8_t {
+    MEM_GENERAL,
+    MEM_LEVEL,
+    MEM_AUDIO,
+    MEM_TEXTURES,
+    MEM_INVENTORY,
+    MEM_AI,
+    MEM_FRAME,
+    MEM_TAG_COUNT
+};
+
+inline const char* memoryTagName(MemoryTag tag) {
+    static const char* const names[MEM_TAG_COUNT] = {"general", "level", "audio", "textures", "inventory", "ai", "frame"};
+    return tag < MEM_TAG_COUNT ? names[tag] : "unknown";
+}
+
+class MemoryTracker {
+public:
+    struct TagStats {
+        size_t current;
+        size_t peak;
+        size_t budget;                   // 0 = none
+        uint64_t allocations;
+        uint64_t lastFrameAllocations;
+        uint64_t peakFrameAllocations;
+        uint64_t lastFrameBytes;         // bytes allocated during the last finished frame
+    };
+
+    static MemoryTracker& instance() {
+        static MemoryTracker tracker;
+        return tracker;
+    }
+
+    void recordAlloc(MemoryTag tag, size_t bytes) {
+        Counters& c = tags[tag];
+        size_t now = c.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t high = c.peak.load(std::memory_order_relaxed);
+        while (now > high && !c.peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {
+        }
+        c.allocations.fetch_add(1, std::memory_order_relaxed);
+        c.frameAllocations.fetch_add(1, std::memory_order_relaxed);
+        c.frameBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void recordFree(MemoryTag tag, size_t bytes) {
+        tags[tag].current.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    void setBudget(MemoryTag tag, size_t bytes) {
+        tags[tag].budget.store(bytes);
+    }
+
+    // Closes the per-frame allocation counters; call once per frame
+    void endFrame() {
+        for (Counters& c : tags) {
+            uint64_t count = c.frameAllocations.exchange(0, std::memory_order_relaxed);
+            c.lastFrameAllocations.store(count, std::memory_order_relaxed);
+            c.lastFrameBytes.store(c.frameBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+            if (count > c.peakFrameAllocations.load(std::memory_order_relaxed))
+                c.peakFrameAllocations.store(count, std::memory_order_relaxed);
+        }
+    }
+
+    TagStats stats(MemoryTag tag) const {
+        const Counters& c = tags[tag];
+        return {c.current.load(), c.peak.load(), c.budget.load(), c.allocations.load(),
+                c.lastFrameAllocations.load(), c.peakFrameAllocations.load(), c.lastFrameBytes.load()};
+    }
+
+    bool overBudget(MemoryTag tag) const {
+        TagStats s = stats(tag);
+        return s.budget > 0 && s.peak > s.budget;
+    }
+
+    bool anyOverBudget() const {
+        for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+            if (overBudget((MemoryTag)t))
+                return true;
+        }
+        return false;
+    }
+
+    // Human-readable table of every tag that has seen an allocation or has a budget
+    void dump(std::ostream& out) const {
+        out << "Memory by subsystem (KB): current / peak / budget, allocations (last frame, peak frame)" << std::endl;
+        for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+            TagStats s = stats((MemoryTag)t);
+            if (s.allocations == 0 && s.budget == 0)
+                continue;
+            out << "  " << memoryTagName((MemoryTag)t) << ": " << s.current / 1024 << " / " << s.peak / 1024 << " / ";
+            if (s.budget > 0)
+                out << s.budget / 1024;
+            else
+                out << "-";
+            out << ", " << s.allocations << " (" << s.lastFrameAllocations << ", " << s.peakFrameAllocations << ")";
+            if (overBudget((MemoryTag)t))
+                out << "  OVER BUDGET";
+            out << std::endl;
+        }
+    }
+
+    // CSV for CI: one row per tag; returns false if the file could not be written
+    bool writeReport(const std::string& path) const {
+        FILE* out = fopen(path.c_str(), "w");
+        if (!out) {
+            std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+            return false;
+        }
+        fprintf(out, "tag,current_bytes,peak_bytes,budget_bytes,allocations,peak_allocations_per_frame,over_budget\n");
+        for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+            TagStats s = stats((MemoryTag)t);
+            fprintf(out, "%s,%zu,%zu,%zu,%llu,%llu,%d\n", memoryTagName((MemoryTag)t), s.current, s.peak, s.budget,
+                    (unsigned long long)s.allocations, (unsigned long long)s.peakFrameAllocations, overBudget((MemoryTag)t) ? 1 : 0);
+        }
+        return fclose(out) == 0;
+    }
+
+private:
+    struct Counters {
+        std::atomic<size_t> current{0};
+        std::atomic<size_t> peak{0};
+        std::atomic<size_t> budget{0};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> frameAllocations{0};
+        std::atomic<uint64_t> frameBytes{0};
+        std::atomic<uint64_t> lastFrameAllocations{0};
+        std::atomic<uint64_t> lastFrameBytes{0};
+        std::atomic<uint64_t> peakFrameAllocations{0};
+    };
+
+    Counters tags[MEM_TAG_COUNT];
+};
+
+// Tag for allocations the engine does not make itself (SDL's malloc hook reads it). Scopes
+// nest per thread and restore the previous tag when they end.
+class MemoryScope {
+public:
+    explicit MemoryScope(MemoryTag tag) : previous(slot()) {
+        slot() = tag;
+    }
+
+    ~MemoryScope() {
+        slot() = previous;
+    }
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+    static MemoryTag current() {
+        return slot();
+    }
+
+private:
+    MemoryTag previous;
+
+    static MemoryTag& slot() {
+        static thread_local MemoryTag tag = MEM_GENERAL;
+        return tag;
+    }
+};
+
+// STL allocator that reports to the tracker under a fixed tag
+template <class T, MemoryTag Tag>
+class TrackedAllocator {
+public:
+    typedef T value_type;
+
+    template <class U>
+    struct rebind {
+        typedef TrackedAllocator<U, Tag> other;
+    };
+
+    TrackedAllocator() {}
+
+    template <class U>
+    TrackedAllocator(const TrackedAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n) {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+        MemoryTracker::instance().recordAlloc(Tag, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, size_t n) {
+        MemoryTracker::instance().recordFree(Tag, n * sizeof(T));
+        ::operator delete(p);
+    }
+
+    template <class U>
+    bool operator==(const TrackedAllocator<U, Tag>&) const {
+        return true;
+    }
+
+    template <class U>
+    bool operator!=(const TrackedAllocator<U, Tag>&) const {
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,2 @@
+all:
+	g++ -I src/include -o packer asset_packer.cpp
\ No newline at end of file
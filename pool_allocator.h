@@ -0,0 +1,252 @@
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "memory_tracker.h"
+
+// Fixed-size object pools. Objects of one type live in slabs of SLAB_OBJECTS slots; freed
+// slots go on an intrusive free list and are handed out again before a new slab is made,
+// so a steady spawn/despawn cycle stops touching malloc once the pool has warmed up.
+// Slabs are only released when the pool is destroyed.
+//
+// The central free list is guarded by a mutex. Threads that allocate heavily can put a
+// PoolCache in front of it, which moves slots to and from the pool in batches.
+//
+// Slab memory is reported to the MemoryTracker under the pool's tag.
+
+struct PoolStats {
+    size_t objectSize;
+    size_t slabs;
+    size_t live;          // allocated and not yet freed
+    size_t peak;          // highest `live` seen
+    size_t allocations;   // total over the pool's life
+};
+
+template <class T, size_t SLAB_OBJECTS = 256>
+class ObjectPool {
+public:
+    explicit ObjectPool(const char* name = typeid(T).name(), MemoryTag tag = MEM_GENERAL)
+        : name(name), tag(tag), tracker(MemoryTracker::instance()), freeHead(nullptr), live(0), peak(0), allocations(0) {}
+
+    // Reports objects that were never freed; their destructors are not run
+    ~ObjectPool() {
+        size_t leaked = live.load();
+        if (leaked > 0)
+            std::cerr << "Pool " << name << ": " << leaked << " objects leaked" << std::endl;
+        tracker.recordFree(tag, slabs.size() * SLAB_BYTES);
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    template <class... Args>
+    T* create(Args&&... args) {
+        void* slot = allocate();
+        try {
+            return new (slot) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(slot);
+            throw;
+        }
+    }
+
+    void destroy(T* object) {
+        if (!object)
+            return;
+        object->~T();
+        deallocate(object);
+    }
+
+    // Raw slot of sizeof(T) bytes, aligned for T
+    void* allocate() {
+        void* slot;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            slot = popLocked();
+        }
+        noteAllocated(1);
+        return slot;
+    }
+
+    void deallocate(void* slot) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            pushLocked(slot);
+        }
+        live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    PoolStats stats() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        return {sizeof(T), slabs.size(), live.load(), peak.load(), allocations.load()};
+    }
+
+    // One line of usage; label defaults to the pool's name
+    void report(std::ostream& out, const char* label = nullptr) const {
+        PoolStats s = stats();
+        out << "Pool " << (label ? label : name) << ": " << s.live << " live (peak " << s.peak << "), " << s.allocations
+            << " allocations, " << s.slabs << " slabs of " << SLAB_OBJECTS << " x " << s.objectSize << " bytes" << std::endl;
+    }
+
+private:
+    template <class, size_t, size_t> friend class PoolCache;
+
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    static constexpr size_t SLAB_BYTES = SLAB_OBJECTS * sizeof(Slot);
+
+    const char* name;
+    MemoryTag tag;
+    MemoryTracker& tracker;   // fetched at construction so the tracker outlives static pools
+    mutable std::mutex mtx;
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    Slot* freeHead;
+    std::atomic<size_t> live;
+    std::atomic<size_t> peak;
+    std::atomic<size_t> allocations;
+
+    void* popLocked() {
+        if (!freeHead) {
+            slabs.emplace_back(new Slot[SLAB_OBJECTS]);
+            Slot* slab = slabs.back().get();
+            for (size_t i = 0; i < SLAB_OBJECTS; ++i)
+                slab[i].next = i + 1 < SLAB_OBJECTS ? &slab[i + 1] : nullptr;
+            freeHead = slab;
+            tracker.recordAlloc(tag, SLAB_BYTES);
+        }
+        Slot* slot = freeHead;
+        freeHead = slot->next;
+        return slot;
+    }
+
+    void pushLocked(void* p) {
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = freeHead;
+        freeHead = slot;
+    }
+
+    void noteAllocated(size_t count) {
+        allocations.fetch_add(count, std::memory_order_relaxed);
+        size_t now = live.fetch_add(count, std::memory_order_relaxed) + count;
+        size_t high = peak.load(std::memory_order_relaxed);
+        while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+// Per-thread front for an ObjectPool: keeps up to LIMIT free slots locally and refills or
+// drains them in batches of LIMIT / 2, so most allocations take no lock. Use one per thread
+// and destroy it before the pool; slots freed through any cache may be reused by any other.
+template <class T, size_t SLAB_OBJECTS = 256, size_t LIMIT = 64>
+class PoolCache {
+public:
+    explicit PoolCache(ObjectPool<T, SLAB_OBJECTS>& pool) : pool(pool), count(0) {}
+
+    ~PoolCache() {
+        flush(count);
+    }
+
+    PoolCache(const PoolCache&) = delete;
+    PoolCache& operator=(const PoolCache&) = delete;
+
+    template <class... Args>
+    T* create(Args&&... args) {
+        void* slot = allocate();
+        try {
+            return new (slot) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(slot);
+            throw;
+        }
+    }
+
+    void destroy(T* object) {
+        if (!object)
+            return;
+        object->~T();
+        deallocate(object);
+    }
+
+    void* allocate() {
+        if (count == 0) {
+            std::lock_guard<std::mutex> lock(pool.mtx);
+            while (count < LIMIT / 2)
+                slots[count++] = pool.popLocked();
+        }
+        pool.noteAllocated(1);
+        return slots[--count];
+    }
+
+    void deallocate(void* slot) {
+        if (count == LIMIT)
+            flush(LIMIT / 2);
+        slots[count++] = slot;
+        pool.live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+private:
+    ObjectPool<T, SLAB_OBJECTS>& pool;
+    void* slots[LIMIT];
+    size_t count;
+
+    void flush(size_t n) {
+        if (n == 0)
+            return;
+        std::lock_guard<std::mutex> lock(pool.mtx);
+        while (n-- > 0)
+            pool.pushLocked(slots[--count]);
+    }
+};
+
+// Mixin that routes `new T` and `delete` of T through a shared ObjectPool<T>, so existing
+// new/delete call sites stop hitting malloc. With ThreadCached, each thread allocates through
+// its own PoolCache. Derived classes of T that add members fall back to the global heap.
+// Tag is the subsystem the pool's memory is charged to.
+template <class T, bool ThreadCached = false, MemoryTag Tag = MEM_GENERAL>
+class Pooled {
+public:
+    static void* operator new(size_t size) {
+        if (size != sizeof(T))
+            return ::operator new(size);
+        return ThreadCached ? cache().allocate() : pool().allocate();
+    }
+
+    static void operator delete(void* p, size_t size) {
+        if (!p)
+            return;
+        if (size != sizeof(T)) {
+            ::operator delete(p);
+            return;
+        }
+        if (ThreadCached)
+            cache().deallocate(p);
+        else
+            pool().deallocate(p);
+    }
+
+    static ObjectPool<T>& pool() {
+        static ObjectPool<T> instance(typeid(T).name(), Tag);
+        return instance;
+    }
+
+private:
+    static PoolCache<T>& cache() {
+        ObjectPool<T>& shared = pool();   // constructed first, so it outlives every thread's cache
+        static thread_local PoolCache<T> local(shared);
+        return local;
+    }
+};
+
+#endif
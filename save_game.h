@@ -0,0 +1,313 @@
+#ifndef SAVE_GAME_H
+#define SAVE_GAME_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary save games: player position, velocity, level and inventory for any number of players.
+//
+// Layout (host byte order, every field 4-byte aligned):
+//   header   magic "GSAV", format version, player count, byte-order mark       16 bytes
+//   table    file offset (uint64) of each player record, sorted by player id   8 bytes each
+//   records  record size, player id, level id, x, y, velocity x, velocity y,
+//            item count (32 bytes), then (item id, quantity) pairs sorted by id
+//
+// Records carry their own size so readers of this version skip fields appended by later ones.
+// SaveReader maps the file and hands out views that point straight into the mapping, so
+// fields are not converted; a save is refused on a machine whose byte order does not match
+// the mark. Saves from before the mark have 0 there and are read as host order.
+
+const uint32_t SAVE_FORMAT_VERSION = 1;
+const uint32_t SAVE_BYTE_ORDER_MARK = 0x01020304;
+
+struct SavedItem {
+    uint32_t id;
+    int32_t quantity;
+};
+
+// One player's state; for writing, items points at itemCount entries sorted by id
+struct PlayerSaveData {
+    uint32_t playerId;
+    uint32_t levelId;
+    int32_t x;
+    int32_t y;
+    int32_t velocityX;
+    int32_t velocityY;
+    const SavedItem* items;
+    uint32_t itemCount;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() : data(nullptr), size(0) {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = nullptr;
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+        if (size == 0)
+            return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size = (size_t)info.st_size;
+        if (size == 0) {
+            ::close(fd);
+            return true;
+        }
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        data = view == MAP_FAILED ? nullptr : (const unsigned char*)view;
+#endif
+        if (!data) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        mapping = nullptr;
+#else
+        if (data)
+            munmap((void*)data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char* bytes() const {
+        return data;
+    }
+
+    size_t length() const {
+        return size;
+    }
+
+private:
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+// Collects player records and writes them with a single fwrite
+class SaveWriter {
+public:
+    void addPlayer(const PlayerSaveData& player) {
+        uint32_t recordSize = RECORD_HEADER_SIZE + player.itemCount * sizeof(SavedItem);
+        size_t at = records.size();
+        records.resize(at + recordSize);
+        unsigned char* out = &records[at];
+
+        uint32_t fields[8] = {recordSize, player.playerId, player.levelId, (uint32_t)player.x, (uint32_t)player.y,
+                              (uint32_t)player.velocityX, (uint32_t)player.velocityY, player.itemCount};
+        memcpy(out, fields, RECORD_HEADER_SIZE);
+        if (player.itemCount > 0)
+            memcpy(out + RECORD_HEADER_SIZE, player.items, player.itemCount * sizeof(SavedItem));
+        index.push_back({player.playerId, at});
+    }
+
+    bool writeFile(const std::string& path) {
+        std::sort(index.begin(), index.end());
+        uint64_t recordsStart = HEADER_SIZE + index.size() * sizeof(uint64_t);
+
+        std::vector<unsigned char> head(recordsStart);
+        uint32_t header[4] = {0, SAVE_FORMAT_VERSION, (uint32_t)index.size(), SAVE_BYTE_ORDER_MARK};
+        memcpy(header, "GSAV", 4);
+        memcpy(head.data(), header, HEADER_SIZE);
+        for (size_t i = 0; i < index.size(); ++i) {
+            uint64_t offset = recordsStart + index[i].second;
+            memcpy(&head[HEADER_SIZE + i * sizeof(uint64_t)], &offset, sizeof(uint64_t));
+        }
+
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+            return false;
+        }
+        bool ok = fwrite(head.data(), 1, head.size(), out) == head.size()
+            && fwrite(records.data(), 1, records.size(), out) == records.size();
+        ok = fclose(out) == 0 && ok;
+        if (!ok)
+            std::cerr << "Error: Failed writing " << path << std::endl;
+        return ok;
+    }
+
+    static constexpr uint32_t HEADER_SIZE = 16;
+    static constexpr uint32_t RECORD_HEADER_SIZE = 32;
+
+private:
+    std::vector<unsigned char> records;
+    std::vector<std::pair<uint32_t, size_t>> index;   // player id -> offset in records
+};
+
+// Zero-copy view of a save file; open() validates every record so views can be used unchecked
+class SaveReader {
+public:
+    bool open(const std::string& path) {
+        count = 0;
+        if (!file.open(path)) {
+            std::cerr << "Error: Could not open " << path << " for reading." << std::endl;
+            return false;
+        }
+
+        const unsigned char* data = file.bytes();
+        size_t size = file.length();
+        uint32_t header[4];
+        if (size < SaveWriter::HEADER_SIZE || memcmp(data, "GSAV", 4) != 0) {
+            std::cerr << "Error: " << path << " is not a save game." << std::endl;
+            return false;
+        }
+        memcpy(header, data, SaveWriter::HEADER_SIZE);
+        if (header[3] != SAVE_BYTE_ORDER_MARK && header[3] != 0) {
+            std::cerr << "Error: " << path << " was written on a machine with a different byte order." << std::endl;
+            return false;
+        }
+        if (header[1] > SAVE_FORMAT_VERSION) {
+            std::cerr << "Error: " << path << " was written by a newer version (" << header[1] << ")." << std::endl;
+            return false;
+        }
+
+        uint64_t players = header[2];
+        if (players > (size - SaveWriter::HEADER_SIZE) / sizeof(uint64_t)) {
+            std::cerr << "Error: " << path << " is truncated." << std::endl;
+            return false;
+        }
+        for (uint64_t i = 0; i < players; ++i) {
+            if (!validRecord(offsetOf(i), size)) {
+                std::cerr << "Error: " << path << " has a damaged record." << std::endl;
+                return false;
+            }
+        }
+        count = players;
+        return true;
+    }
+
+    uint32_t playerCount() const {
+        return count;
+    }
+
+    void player(uint32_t index, PlayerSaveData& out) const {
+        const unsigned char* record = file.bytes() + offsetOf(index);
+        uint32_t fields[8];
+        memcpy(fields, record, SaveWriter::RECORD_HEADER_SIZE);
+        out.playerId = fields[1];
+        out.levelId = fields[2];
+        out.x = (int32_t)fields[3];
+        out.y = (int32_t)fields[4];
+        out.velocityX = (int32_t)fields[5];
+        out.velocityY = (int32_t)fields[6];
+        out.itemCount = fields[7];
+        out.items = (const SavedItem*)(record + SaveWriter::RECORD_HEADER_SIZE);
+    }
+
+    // Binary search on the player-sorted table
+    bool findPlayer(uint32_t playerId, PlayerSaveData& out) const {
+        uint32_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (playerIdAt(mid) < playerId)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo == count || playerIdAt(lo) != playerId)
+            return false;
+        player(lo, out);
+        return true;
+    }
+
+private:
+    MappedFile file;
+    uint32_t count;
+
+    uint64_t offsetOf(uint64_t index) const {
+        uint64_t offset;
+        memcpy(&offset, file.bytes() + SaveWriter::HEADER_SIZE + index * sizeof(uint64_t), sizeof(uint64_t));
+        return offset;
+    }
+
+    uint32_t playerIdAt(uint32_t index) const {
+        uint32_t id;
+        memcpy(&id, file.bytes() + offsetOf(index) + 4, 4);
+        return id;
+    }
+
+    bool validRecord(uint64_t offset, size_t size) const {
+        if (offset % 4 != 0 || offset > size || size - offset < SaveWriter::RECORD_HEADER_SIZE)
+            return false;
+        uint32_t fields[8];
+        memcpy(fields, file.bytes() + offset, SaveWriter::RECORD_HEADER_SIZE);
+        uint64_t itemBytes = (uint64_t)fields[7] * sizeof(SavedItem);
+        if (fields[0] % 4 != 0 || fields[0] < SaveWriter::RECORD_HEADER_SIZE + itemBytes || fields[0] > size - offset)
+            return false;
+
+        const SavedItem* items = (const SavedItem*)(file.bytes() + offset + SaveWriter::RECORD_HEADER_SIZE);
+        for (uint32_t i = 1; i < fields[7]; ++i) {
+            if (items[i - 1].id >= items[i].id)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
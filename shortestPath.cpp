@@ -1,8 +1,30 @@
 #include <iostream>
 #include <vector>
-#include <queue>
 #include <limits>
 #include <cmath>
+#include <deque>
+#include <list>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 #define INF numeric_limits<int>::max()
@@ -14,54 +36,703 @@ struct Edge {
     int weight;
 };
 
-// Function to perform Dijkstra's algorithm
-void dijkstra(vector<vector<Edge>>& graph, int source, vector<int>& dist, vector<int>& prev) {
-    int V = graph.size();
+// Compressed sparse row graph: the edges leaving u are targets/weights[offsets[u] .. offsets[u + 1])
+struct CsrGraph {
+    vector<int> offsets;   // vertexCount + 1 entries
+    vector<int> targets;
+    vector<int> weights;
+
+    int vertexCount() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    int edgeCount() const {
+        return targets.size();
+    }
+};
+
+// Collects edges in any order, then packs them into a CsrGraph with a counting sort
+class CsrGraphBuilder {
+public:
+    CsrGraphBuilder(int vertexCount) : vertexCount(vertexCount) {}
+
+    void addEdge(int from, int to, int weight) {
+        edges.push_back({from, {to, weight}});
+    }
+
+    CsrGraph build() const {
+        CsrGraph graph;
+        graph.offsets.assign(vertexCount + 1, 0);
+        for (const pair<int, Edge>& e : edges)
+            ++graph.offsets[e.first + 1];
+        for (int u = 0; u < vertexCount; ++u)
+            graph.offsets[u + 1] += graph.offsets[u];
+
+        graph.targets.resize(edges.size());
+        graph.weights.resize(edges.size());
+        vector<int> cursor(graph.offsets.begin(), graph.offsets.end() - 1);
+        for (const pair<int, Edge>& e : edges) {
+            int slot = cursor[e.first]++;
+            graph.targets[slot] = e.second.to;
+            graph.weights[slot] = e.second.weight;
+        }
+        return graph;
+    }
+
+private:
+    int vertexCount;
+    vector<pair<int, Edge>> edges;
+};
+
+// Navigation graph over a level's tile map. Cell (x, y) is vertex y * width + x;
+// solid tiles (1) and cells past the end of a short row have no edges.
+struct TileGraph {
+    CsrGraph graph;
+    int width;
+    int height;
+
+    int cellId(int x, int y) const {
+        return y * width + x;
+    }
+};
+
+bool isWalkableTile(const vector<vector<int>>& tiles, int x, int y) {
+    return y >= 0 && y < (int)tiles.size() && x >= 0 && x < (int)tiles[y].size() && tiles[y][x] != 1;
+}
+
+// Function to convert a tile map (as loaded from level_config.txt) into a 4-connected graph
+TileGraph tileMapToCsr(const vector<vector<int>>& tiles) {
+    TileGraph tileGraph;
+    tileGraph.height = tiles.size();
+    tileGraph.width = 0;
+    for (const vector<int>& row : tiles)
+        tileGraph.width = max(tileGraph.width, (int)row.size());
+
+    const int dx[4] = {1, -1, 0, 0};
+    const int dy[4] = {0, 0, 1, -1};
+    CsrGraphBuilder builder(tileGraph.width * tileGraph.height);
+    for (int y = 0; y < tileGraph.height; ++y) {
+        for (int x = 0; x < tileGraph.width; ++x) {
+            if (!isWalkableTile(tiles, x, y))
+                continue;
+            for (int k = 0; k < 4; ++k) {
+                if (isWalkableTile(tiles, x + dx[k], y + dy[k]))
+                    builder.addEdge(tileGraph.cellId(x, y), tileGraph.cellId(x + dx[k], y + dy[k]), 1);
+            }
+        }
+    }
+    tileGraph.graph = builder.build();
+    return tileGraph;
+}
+
+// Function to read a tile map in the level_config.txt format (one row of tile ids per line)
+bool loadTileMap(const string& configFile, vector<vector<int>>& tiles) {
+    ifstream inFile(configFile);
+    if (!inFile.is_open())
+        return false;
+
+    tiles.clear();
+    string line;
+    while (getline(inFile, line)) {
+        vector<int> row;
+        istringstream ss(line);
+        int tile;
+        while (ss >> tile)
+            row.push_back(tile);
+        tiles.push_back(row);
+    }
+    return true;
+}
+
+// Open lists for dijkstra. Each provides reset/empty/push/pop; pop may hand back
+// a stale (vertex, key) pair, which dijkstra skips by comparing against dist.
+
+// The original lazy binary heap: improved vertices are pushed again as duplicates
+class LazyBinaryHeap {
+public:
+    void reset(int /*vertexCount*/) {
+        heap.clear();
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    void push(int v, int key) {
+        heap.push_back({key, v});
+        push_heap(heap.begin(), heap.end(), greater<pair<int, int>>());
+    }
+
+    int pop(int& key) {
+        pop_heap(heap.begin(), heap.end(), greater<pair<int, int>>());
+        key = heap.back().first;
+        int v = heap.back().second;
+        heap.pop_back();
+        return v;
+    }
+
+private:
+    vector<pair<int, int>> heap;
+};
+
+// Indexed 4-ary min-heap with decrease-key: every vertex is queued at most once,
+// keys and vertices live in parallel arrays so a node's four children are one cache line
+class QuadHeap {
+public:
+    void reset(int vertexCount) {
+        pos.assign(vertexCount, -1);
+        keys.clear();
+        verts.clear();
+    }
+
+    bool empty() const {
+        return keys.empty();
+    }
+
+    // Inserts v, or lowers its key when it is already queued
+    void push(int v, int key) {
+        int i = pos[v];
+        if (i < 0) {
+            i = keys.size();
+            keys.push_back(key);
+            verts.push_back(v);
+        } else if (key >= keys[i]) {
+            return;
+        }
+        siftUp(i, v, key);
+    }
+
+    int pop(int& key) {
+        key = keys[0];
+        int v = verts[0];
+        pos[v] = -1;
+
+        int lastKey = keys.back();
+        int lastVert = verts.back();
+        keys.pop_back();
+        verts.pop_back();
+        if (!keys.empty())
+            siftDown(0, lastVert, lastKey);
+        return v;
+    }
+
+private:
+    vector<int> pos;    // heap slot of each vertex, -1 when not queued
+    vector<int> keys;
+    vector<int> verts;
+
+    void place(int i, int v, int key) {
+        keys[i] = key;
+        verts[i] = v;
+        pos[v] = i;
+    }
+
+    void siftUp(int i, int v, int key) {
+        while (i > 0) {
+            int parent = (i - 1) >> 2;
+            if (keys[parent] <= key)
+                break;
+            place(i, verts[parent], keys[parent]);
+            i = parent;
+        }
+        place(i, v, key);
+    }
+
+    void siftDown(int i, int v, int key) {
+        int n = keys.size();
+        while (true) {
+            int first = 4 * i + 1;
+            if (first >= n)
+                break;
+            int last = min(first + 4, n);
+            int best = first;
+            for (int c = first + 1; c < last; ++c) {
+                if (keys[c] < keys[best])
+                    best = c;
+            }
+            if (keys[best] >= key)
+                break;
+            place(i, verts[best], keys[best]);
+            i = best;
+        }
+        place(i, v, key);
+    }
+};
+
+// Monotone radix heap for non-negative integer keys. Keys are bucketed by the highest
+// bit that differs from the last popped key, so each entry is moved at most 32 times.
+// Like the lazy heap it keeps duplicates instead of supporting decrease-key.
+class RadixHeap {
+public:
+    void reset(int /*vertexCount*/) {
+        for (vector<pair<unsigned int, int>>& bucket : buckets)
+            bucket.clear();
+        last = 0;
+        count = 0;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    // key must not be smaller than the last popped key
+    void push(int v, int key) {
+        buckets[bucketFor(key)].push_back({(unsigned int)key, v});
+        ++count;
+    }
+
+    int pop(int& key) {
+        if (buckets[0].empty()) {
+            int b = 1;
+            while (buckets[b].empty())
+                ++b;
+
+            unsigned int smallest = buckets[b][0].first;
+            for (const pair<unsigned int, int>& entry : buckets[b])
+                smallest = min(smallest, entry.first);
+            last = smallest;
+
+            for (const pair<unsigned int, int>& entry : buckets[b])
+                buckets[bucketFor(entry.first)].push_back(entry);
+            buckets[b].clear();
+        }
+
+        key = buckets[0].back().first;
+        int v = buckets[0].back().second;
+        buckets[0].pop_back();
+        --count;
+        return v;
+    }
+
+private:
+    vector<pair<unsigned int, int>> buckets[33];
+    unsigned int last;
+    int count;
+
+    int bucketFor(unsigned int key) const {
+        return key == last ? 0 : 32 - __builtin_clz(key ^ last);
+    }
+};
+
+// Scratch buffers reused across searches so repeated queries do not reallocate
+template <class OpenList>
+struct SearchScratch {
+    vector<int> dist;
+    vector<int> prev;
+    OpenList open;
+};
+
+typedef SearchScratch<QuadHeap> PathScratch;
+
+// Dijkstra from source into scratch; stops once target is settled (target -1 runs to completion)
+template <class OpenList>
+void dijkstra(const CsrGraph& graph, int source, SearchScratch<OpenList>& scratch, int target = -1) {
+    int V = graph.vertexCount();
+    vector<int>& dist = scratch.dist;
+    vector<int>& prev = scratch.prev;
+    OpenList& open = scratch.open;
 
     dist.assign(V, INF);
     prev.assign(V, -1);
+    open.reset(V);
 
-    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> pq;
     dist[source] = 0;
-    pq.push({0, source});
+    open.push(source, 0);
 
-    while (!pq.empty()) {
-        int u = pq.top().second;
-        int d = pq.top().first;
-        pq.pop();
+    while (!open.empty()) {
+        int d;
+        int u = open.pop(d);
 
         if (d > dist[u])
             continue;
+        if (u == target)
+            break;
 
-        for (const Edge& e : graph[u]) {
-            int v = e.to;
-            int w = e.weight;
+        int edgeEnd = graph.offsets[u + 1];
+        for (int e = graph.offsets[u]; e < edgeEnd; ++e) {
+            int v = graph.targets[e];
+            int w = graph.weights[e];
 
             if (dist[u] + w < dist[v]) {
                 dist[v] = dist[u] + w;
                 prev[v] = u;
-                pq.push({dist[v], v});
+                open.push(v, dist[v]);
             }
         }
     }
 }
 
+// Function to perform Dijkstra's algorithm
+void dijkstra(const CsrGraph& graph, int source, vector<int>& dist, vector<int>& prev) {
+    PathScratch scratch;
+    scratch.dist.swap(dist);
+    scratch.prev.swap(prev);
+    dijkstra(graph, source, scratch);
+    dist.swap(scratch.dist);
+    prev.swap(scratch.prev);
+}
+
+// Function to rebuild the path ending at target from the prev links (source first)
+void buildPath(const vector<int>& prev, int target, vector<int>& path) {
+    path.clear();
+    for (int at = target; at != -1; at = prev[at])
+        path.push_back(at);
+    reverse(path.begin(), path.end());
+}
+
 // Function to print the shortest path from source to target
 void printShortestPath(vector<int>& prev, int target) {
     vector<int> path;
-    for (int at = target; at != -1; at = prev[at])
-        path.push_back(at);
+    buildPath(prev, target, path);
 
     cout << "Shortest Path: ";
-    for (int i = path.size() - 1; i >= 0; --i) {
+    for (size_t i = 0; i < path.size(); ++i) {
         cout << path[i];
-        if (i != 0)
+        if (i + 1 != path.size())
             cout << " -> ";
     }
     sizeofshortest=path.size();
     cout << endl;
 }
 
+// Result of one asynchronous path query
+struct PathResult {
+    int cost;          // INF when the goal is unreachable
+    vector<int> path;  // start ... goal, empty when unreachable
+};
+
+// Counters exposed by PathCache
+struct PathCacheStats {
+    long long hits;         // exact start/goal matches
+    long long suffixHits;   // answered from the tail of a longer cached path
+    long long misses;
+    long long evictions;
+    long long invalidated;
+    size_t entries;
+    size_t bytes;
+
+    double hitRate() const {
+        long long total = hits + suffixHits + misses;
+        return total == 0 ? 0.0 : double(hits + suffixHits) / total;
+    }
+};
+
+// LRU cache of shortest paths keyed by (start, goal, map version). Every cell of a
+// cached path is indexed against its goal, since the tail of a shortest path is itself
+// the shortest path from that cell, so one entry answers queries from any cell on it.
+class PathCache {
+public:
+    PathCache(size_t maxBytes) : maxBytes(maxBytes) {
+        stats = PathCacheStats();
+    }
+
+    // Fills result and returns true when (start, goal) is answered by a path cached for mapVersion
+    bool lookup(int start, int goal, unsigned int mapVersion, PathResult& result) {
+        auto it = index.find(cellKey(start, goal));
+        if (it == index.end() || it->second.entry->mapVersion != mapVersion) {
+            ++stats.misses;
+            return false;
+        }
+
+        const CacheEntry& entry = *it->second.entry;
+        int pos = it->second.pos;
+        if (pos < 0) {
+            result.cost = INF;
+            result.path.clear();
+        } else {
+            result.cost = entry.costs.back() - entry.costs[pos];
+            result.path.assign(entry.path.begin() + pos, entry.path.end());
+        }
+        if (pos <= 0)
+            ++stats.hits;
+        else
+            ++stats.suffixHits;
+
+        lru.splice(lru.begin(), lru, it->second.entry);
+        return true;
+    }
+
+    // Stores a search result; pathCosts[i] is the cost from start to path[i] (empty path = unreachable)
+    void insert(int start, int goal, unsigned int mapVersion, const vector<int>& path, const vector<int>& pathCosts) {
+        lru.push_front(CacheEntry());
+        CacheEntry& entry = lru.front();
+        entry.start = start;
+        entry.goal = goal;
+        entry.mapVersion = mapVersion;
+        entry.path = path;
+        entry.costs = pathCosts;
+
+        if (path.empty()) {
+            index[cellKey(start, goal)] = {lru.begin(), -1};
+        } else {
+            for (size_t i = 0; i < path.size(); ++i)
+                index[cellKey(path[i], goal)] = {lru.begin(), (int)i};
+        }
+        stats.bytes += entryBytes(entry);
+        ++stats.entries;
+
+        while (stats.bytes > maxBytes && stats.entries > 1) {
+            erase(prev(lru.end()));
+            ++stats.evictions;
+        }
+    }
+
+    // Carries paths cached for oldVersion over to newVersion after an edit to the rectangle
+    // (inclusive, in cells of a 4-connected grid `width` wide). An entry is kept only if it
+    // avoids the rectangle and no route through the rectangle could beat it: minStepCost is a
+    // lower bound on any step's cost in the edited map, so every route via the rectangle from
+    // a cached cell costs at least its grid distance to the rectangle and on to the goal times
+    // minStepCost. Everything else, including "unreachable" answers and entries for other
+    // versions, is dropped. Pass minStepCost 0 to drop every entry the edit could affect.
+    void invalidateRegion(int width, int x0, int y0, int x1, int y1, int minStepCost,
+                          unsigned int oldVersion, unsigned int newVersion) {
+        for (auto it = lru.begin(); it != lru.end();) {
+            auto next = std::next(it);
+            bool keep = it->mapVersion == oldVersion && !it->path.empty();
+            if (keep) {
+                long long viaRegionFromGoal = (long long)rectDistance(it->goal % width, it->goal / width, x0, y0, x1, y1);
+                for (size_t i = 0; i < it->path.size() && keep; ++i) {
+                    int x = it->path[i] % width;
+                    int y = it->path[i] / width;
+                    long long cellToRegion = rectDistance(x, y, x0, y0, x1, y1);
+                    long long cached = it->costs.back() - it->costs[i];
+                    keep = cellToRegion > 0 && cached <= (cellToRegion + viaRegionFromGoal) * minStepCost;
+                }
+            }
+            if (keep) {
+                it->mapVersion = newVersion;
+            } else {
+                erase(it);
+                ++stats.invalidated;
+            }
+            it = next;
+        }
+    }
+
+    const PathCacheStats& getStats() const {
+        return stats;
+    }
+
+private:
+    struct CacheEntry {
+        int start;
+        int goal;
+        unsigned int mapVersion;
+        vector<int> path;
+        vector<int> costs;
+    };
+
+    struct IndexSlot {
+        list<CacheEntry>::iterator entry;
+        int pos;   // index of the cell in entry.path, -1 for an unreachable answer
+    };
+
+    size_t maxBytes;
+    list<CacheEntry> lru;   // most recently used first
+    unordered_map<long long, IndexSlot> index;
+    PathCacheStats stats;
+
+    // Fewest 4-connected steps from (x, y) to the rectangle, 0 inside it
+    static int rectDistance(int x, int y, int x0, int y0, int x1, int y1) {
+        return max({x0 - x, x - x1, 0}) + max({y0 - y, y - y1, 0});
+    }
+
+    static long long cellKey(int cell, int goal) {
+        return ((long long)cell << 32) | (unsigned int)goal;
+    }
+
+    static size_t entryBytes(const CacheEntry& entry) {
+        size_t indexed = entry.path.empty() ? 1 : entry.path.size();
+        return sizeof(CacheEntry) + 2 * sizeof(void*)
+            + (entry.path.capacity() + entry.costs.capacity()) * sizeof(int)
+            + indexed * (sizeof(pair<const long long, IndexSlot>) + 2 * sizeof(void*));
+    }
+
+    void erase(list<CacheEntry>::iterator it) {
+        if (it->path.empty()) {
+            index.erase(cellKey(it->start, it->goal));
+        } else {
+            for (int cell : it->path) {
+                auto slot = index.find(cellKey(cell, it->goal));
+                if (slot != index.end() && slot->second.entry == it)
+                    index.erase(slot);
+            }
+        }
+        stats.bytes -= entryBytes(*it);
+        --stats.entries;
+        lru.erase(it);
+    }
+};
+
+// Function to answer a query from the cache, falling back to dijkstra on a miss
+template <class OpenList>
+void findPathCached(PathCache& cache, unsigned int mapVersion, const CsrGraph& graph, SearchScratch<OpenList>& scratch,
+                    int start, int goal, PathResult& result) {
+    if (cache.lookup(start, goal, mapVersion, result))
+        return;
+
+    dijkstra(graph, start, scratch, goal);
+    result.cost = scratch.dist[goal];
+    result.path.clear();
+    vector<int> costs;
+    if (result.cost != INF) {
+        buildPath(scratch.prev, goal, result.path);
+        for (int cell : result.path)
+            costs.push_back(scratch.dist[cell]);
+    }
+    cache.insert(start, goal, mapVersion, result.path, costs);
+}
+
+// One queued query; identical start/goal requests share a job
+struct PathJob {
+    int start;
+    int goal;
+    bool ready;        // only touched on the thread that calls update()
+    PathResult result;
+    vector<int> pathCosts;
+};
+
+typedef shared_ptr<PathJob> PathHandle;
+
+// Asynchronous path query service. Gameplay calls request() and gets a handle,
+// worker threads run the searches, and update() (once per frame, from the game
+// loop) delivers finished results so poll() only ever reads main-thread state.
+// The graph must not change while the service is alive. With a cache attached,
+// hits are ready immediately and delivered results are added to it in update().
+class PathService {
+public:
+    PathService(const CsrGraph& graph, int workerCount, int frameBudgetMicros)
+        : graph(graph), cache(nullptr), mapVersion(0), frameBudgetMicros(frameBudgetMicros), usedMicros(0), stopping(false) {
+        if (workerCount < 1)
+            workerCount = 1;
+        for (int i = 0; i < workerCount; ++i)
+            workers.emplace_back(&PathService::workerLoop, this);
+    }
+
+    ~PathService() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (thread& t : workers)
+            t.join();
+    }
+
+    PathService(const PathService&) = delete;
+    PathService& operator=(const PathService&) = delete;
+
+    // Attach a main-thread cache; mapVersion is the version of the graph this service searches
+    void setCache(PathCache* pathCache, unsigned int version) {
+        cache = pathCache;
+        mapVersion = version;
+    }
+
+    // Queue a query; returns the in-flight handle when the same pair is already queued. A
+    // vertex outside the graph gives a handle that is already ready and unreachable.
+    PathHandle request(int start, int goal) {
+        if (start < 0 || start >= graph.vertexCount() || goal < 0 || goal >= graph.vertexCount()) {
+            cerr << "Error: Path request " << start << " -> " << goal << " is outside the graph." << endl;
+            PathHandle job = make_shared<PathJob>();
+            job->start = start;
+            job->goal = goal;
+            job->ready = true;
+            job->result.cost = INF;
+            return job;
+        }
+
+        long long key = ((long long)start << 32) | (unsigned int)goal;
+        auto it = inFlight.find(key);
+        if (it != inFlight.end())
+            return it->second;
+
+        PathHandle job = make_shared<PathJob>();
+        job->start = start;
+        job->goal = goal;
+        job->ready = false;
+        if (cache && cache->lookup(start, goal, mapVersion, job->result)) {
+            job->ready = true;
+            return job;
+        }
+        inFlight[key] = job;
+        {
+            lock_guard<mutex> lock(mtx);
+            pending.push_back(job);
+        }
+        cv.notify_one();
+        return job;
+    }
+
+    // Call once per frame: publishes finished jobs and opens the next frame's budget
+    void update() {
+        vector<PathHandle> done;
+        {
+            lock_guard<mutex> lock(mtx);
+            done.swap(finished);
+            usedMicros = 0;
+        }
+        cv.notify_all();
+
+        for (const PathHandle& job : done) {
+            job->ready = true;
+            inFlight.erase(((long long)job->start << 32) | (unsigned int)job->goal);
+            if (cache)
+                cache->insert(job->start, job->goal, mapVersion, job->result.path, job->pathCosts);
+        }
+    }
+
+    // Returns true and fills result once the handle's query has been delivered
+    bool poll(const PathHandle& handle, PathResult& result) const {
+        if (!handle || !handle->ready)
+            return false;
+        result = handle->result;
+        return true;
+    }
+
+private:
+    const CsrGraph& graph;
+    PathCache* cache;
+    unsigned int mapVersion;
+    vector<thread> workers;
+    unordered_map<long long, PathHandle> inFlight;
+
+    mutex mtx;
+    condition_variable cv;
+    deque<PathHandle> pending;
+    vector<PathHandle> finished;
+    long long frameBudgetMicros;
+    long long usedMicros;      // worker time spent this frame; a search is never cut short,
+    bool stopping;             // new ones just wait for the next update() once it runs out
+
+    void workerLoop() {
+        PathScratch scratch;
+        unique_lock<mutex> lock(mtx);
+        while (true) {
+            cv.wait(lock, [this] { return stopping || (!pending.empty() && usedMicros < frameBudgetMicros); });
+            if (stopping)
+                return;
+
+            PathHandle job = pending.front();
+            pending.pop_front();
+            lock.unlock();
+
+            auto begin = chrono::steady_clock::now();
+            dijkstra(graph, job->start, scratch, job->goal);
+            job->result.cost = scratch.dist[job->goal];
+            if (job->result.cost != INF) {
+                buildPath(scratch.prev, job->goal, job->result.path);
+                for (int cell : job->result.path)
+                    job->pathCosts.push_back(scratch.dist[cell]);
+            }
+            long long elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+
+            lock.lock();
+            usedMicros += elapsed;
+            finished.push_back(job);
+        }
+    }
+};
+
 // Function to compare paths
 bool comparePaths(const vector<int>& shortestPath, const vector<int>& samplePath) {
     if (shortestPath.size() != samplePath.size())
@@ -85,24 +756,946 @@ double calculateScore(const vector<int>& shortestPath, const vector<int>& userPa
     return score;
 }
 
-int main() {
-    // Example graph representation (Adjacency List)
+// One player's standing on the leaderboard
+struct LeaderboardEntry {
+    int playerId;
+    double score;
+    long long timestamp;
+};
+
+// Live leaderboard: an order-statistic treap (nodes in one vector, linked by index)
+// ordered by score, then earlier timestamp, then player id. Submissions and rank
+// queries are O(log n); the top K entries are cached so repeated reads are O(1)
+// and the cache is rebuilt in O(K + log n) only after a change that reaches it.
+class Leaderboard {
+public:
+    Leaderboard(int cachedTop = 10) : root(-1), cachedTop(cachedTop), topDirty(false), rng(12345) {}
+
+    int size() const {
+        return byPlayer.size();
+    }
+
+    // Records a run; each player keeps their best score (a tie keeps the earlier run)
+    void submit(int playerId, double score, long long timestamp) {
+        LeaderboardEntry entry = {playerId, score, timestamp};
+        auto it = byPlayer.find(playerId);
+        if (it != byPlayer.end()) {
+            if (!ranksAhead(entry, nodes[it->second].entry))
+                return;
+            remove(playerId);
+        }
+
+        int n = allocNode(entry);
+        int left, right;
+        split(root, entry, left, right);
+        root = merge(merge(left, n), right);
+        byPlayer[playerId] = n;
+        touchTop(entry);
+    }
+
+    void remove(int playerId) {
+        auto it = byPlayer.find(playerId);
+        if (it == byPlayer.end())
+            return;
+        int n = it->second;
+        touchTop(nodes[n].entry);
+        root = erase(root, nodes[n].entry);
+        freeNodes.push_back(n);
+        byPlayer.erase(it);
+    }
+
+    // 1-based rank of the player, 0 when they have no score
+    int rankOf(int playerId) const {
+        auto it = byPlayer.find(playerId);
+        if (it == byPlayer.end())
+            return 0;
+
+        const LeaderboardEntry& entry = nodes[it->second].entry;
+        int rank = 0;
+        int t = root;
+        while (t != -1) {
+            if (ranksAhead(nodes[t].entry, entry)) {
+                rank += sizeOf(nodes[t].left) + 1;
+                t = nodes[t].right;
+            } else if (nodes[t].entry.playerId == playerId) {
+                return rank + sizeOf(nodes[t].left) + 1;
+            } else {
+                t = nodes[t].left;
+            }
+        }
+        return 0;
+    }
+
+    // Entry at a 1-based rank (rank must be in [1, size()])
+    const LeaderboardEntry& entryAt(int rank) const {
+        int t = root;
+        while (true) {
+            int leftSize = sizeOf(nodes[t].left);
+            if (rank <= leftSize) {
+                t = nodes[t].left;
+            } else if (rank == leftSize + 1) {
+                return nodes[t].entry;
+            } else {
+                rank -= leftSize + 1;
+                t = nodes[t].right;
+            }
+        }
+    }
+
+    // Best entries first; at most the cached count, served from the cache without touching the tree
+    const vector<LeaderboardEntry>& top() {
+        if (topDirty) {
+            topCache.clear();
+            collect(root, topCache, cachedTop);
+            topDirty = false;
+        }
+        return topCache;
+    }
+
+    // Replaces the contents with entries already in rank order (one per player), in O(n)
+    void loadRanked(const vector<LeaderboardEntry>& ranked) {
+        nodes.clear();
+        freeNodes.clear();
+        byPlayer.clear();
+        byPlayer.reserve(ranked.size());
+
+        // Cartesian tree build: keep the right spine on a stack, popping lower priorities
+        vector<int> spine;
+        for (const LeaderboardEntry& entry : ranked) {
+            int n = allocNode(entry);
+            byPlayer[entry.playerId] = n;
+            int last = -1;
+            while (!spine.empty() && nodes[spine.back()].priority < nodes[n].priority) {
+                last = spine.back();
+                spine.pop_back();
+            }
+            nodes[n].left = last;
+            if (!spine.empty())
+                nodes[spine.back()].right = n;
+            spine.push_back(n);
+        }
+        root = spine.empty() ? -1 : spine[0];
+
+        // Parents are visited before their children, so sizes are filled in reverse
+        vector<int> order;
+        vector<int> stack;
+        if (root != -1)
+            stack.push_back(root);
+        while (!stack.empty()) {
+            int t = stack.back();
+            stack.pop_back();
+            order.push_back(t);
+            if (nodes[t].left != -1)
+                stack.push_back(nodes[t].left);
+            if (nodes[t].right != -1)
+                stack.push_back(nodes[t].right);
+        }
+        for (int i = order.size() - 1; i >= 0; --i)
+            pull(order[i]);
+
+        topDirty = true;
+    }
+
+    // Best k entries in order; O(k + log n) without disturbing the leaderboard
+    void topK(int k, vector<LeaderboardEntry>& out) const {
+        out.clear();
+        collect(root, out, k);
+    }
+
+private:
+    struct Node {
+        LeaderboardEntry entry;
+        unsigned int priority;
+        int left;
+        int right;
+        int size;
+    };
+
+    vector<Node> nodes;
+    vector<int> freeNodes;
+    unordered_map<int, int> byPlayer;   // player id -> node
+    int root;
+    int cachedTop;
+    vector<LeaderboardEntry> topCache;
+    bool topDirty;
+    mt19937 rng;
+
+    static bool ranksAhead(const LeaderboardEntry& a, const LeaderboardEntry& b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        if (a.timestamp != b.timestamp)
+            return a.timestamp < b.timestamp;
+        return a.playerId < b.playerId;
+    }
+
+    int sizeOf(int t) const {
+        return t == -1 ? 0 : nodes[t].size;
+    }
+
+    void pull(int t) {
+        nodes[t].size = 1 + sizeOf(nodes[t].left) + sizeOf(nodes[t].right);
+    }
+
+    int allocNode(const LeaderboardEntry& entry) {
+        int n;
+        if (!freeNodes.empty()) {
+            n = freeNodes.back();
+            freeNodes.pop_back();
+        } else {
+            n = nodes.size();
+            nodes.push_back(Node());
+        }
+        nodes[n] = {entry, (unsigned int)rng(), -1, -1, 1};
+        return n;
+    }
+
+    // The cache only goes stale when the changed entry is, or would be, among the cached ones
+    void touchTop(const LeaderboardEntry& entry) {
+        if (topDirty)
+            return;
+        if ((int)topCache.size() < cachedTop || !ranksAhead(topCache.back(), entry))
+            topDirty = true;
+    }
+
+    // Splits t into entries ranked ahead of `entry` and the rest
+    void split(int t, const LeaderboardEntry& entry, int& left, int& right) {
+        if (t == -1) {
+            left = right = -1;
+        } else if (ranksAhead(nodes[t].entry, entry)) {
+            split(nodes[t].right, entry, nodes[t].right, right);
+            left = t;
+            pull(t);
+        } else {
+            split(nodes[t].left, entry, left, nodes[t].left);
+            right = t;
+            pull(t);
+        }
+    }
+
+    int merge(int left, int right) {
+        if (left == -1)
+            return right;
+        if (right == -1)
+            return left;
+        if (nodes[left].priority > nodes[right].priority) {
+            nodes[left].right = merge(nodes[left].right, right);
+            pull(left);
+            return left;
+        }
+        nodes[right].left = merge(left, nodes[right].left);
+        pull(right);
+        return right;
+    }
+
+    int erase(int t, const LeaderboardEntry& entry) {
+        if (nodes[t].entry.playerId == entry.playerId)
+            return merge(nodes[t].left, nodes[t].right);
+        if (ranksAhead(nodes[t].entry, entry))
+            nodes[t].right = erase(nodes[t].right, entry);
+        else
+            nodes[t].left = erase(nodes[t].left, entry);
+        pull(t);
+        return t;
+    }
+
+    // In-order walk with an explicit stack, stopping after k entries
+    void collect(int t, vector<LeaderboardEntry>& out, int k) const {
+        vector<int> stack;
+        while ((t != -1 || !stack.empty()) && (int)out.size() < k) {
+            while (t != -1) {
+                stack.push_back(t);
+                t = nodes[t].left;
+            }
+            t = stack.back();
+            stack.pop_back();
+            out.push_back(nodes[t].entry);
+            t = nodes[t].right;
+        }
+    }
+};
+
+// CRC-32 (IEEE) used to detect torn or corrupted records on disk
+unsigned int crc32(const unsigned char* data, size_t length, unsigned int crc = 0) {
+    static unsigned int table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (unsigned int i = 0; i < 256; ++i) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Persistent leaderboard: every submission is appended to <base>.log as a checksummed
+// 32-byte record, and every `snapshotEvery` submissions the ranked state is written
+// to <base>.snap and the log restarted. open() loads the snapshot and replays the log
+// tail, dropping a torn final record. Files use the host's byte order.
+//
+// Records are buffered; flush() hands them to the OS (call it once per frame or batch),
+// which survives a process crash but not a power cut. Snapshots are synced to disk, with
+// their directory entry, before the log is restarted, so a power cut loses at most the
+// records logged since the last snapshot.
+class LeaderboardStore {
+public:
+    LeaderboardStore(Leaderboard& board, const string& basePath, int snapshotEvery = 100000)
+        : board(board), logPath(basePath + ".log"), snapPath(basePath + ".snap"),
+          snapshotEvery(snapshotEvery), sinceSnapshot(0), sequence(0), log(nullptr) {}
+
+    ~LeaderboardStore() {
+        if (log)
+            fclose(log);
+    }
+
+    LeaderboardStore(const LeaderboardStore&) = delete;
+    LeaderboardStore& operator=(const LeaderboardStore&) = delete;
+
+    // Recovers the board from disk and opens the log for appending
+    bool open() {
+        loadSnapshot();
+        replayLog();
+        log = fopen(logPath.c_str(), "ab");
+        if (!log) {
+            cerr << "Error: Could not open " << logPath << " for writing." << endl;
+            return false;
+        }
+        setvbuf(log, nullptr, _IOFBF, 1 << 16);
+        return true;
+    }
+
+    // False if the record could not be logged (the board is left unchanged) or if the
+    // periodic snapshot failed (the score is logged and on the board)
+    bool submit(int playerId, double score, long long timestamp) {
+        if (!log) {
+            cerr << "Error: " << logPath << " is not open." << endl;
+            return false;
+        }
+        LeaderboardEntry entry = {playerId, score, timestamp};
+        unsigned char record[LOG_RECORD_SIZE];
+        encodeRecord(sequence + 1, entry, record);
+        if (fwrite(record, 1, LOG_RECORD_SIZE, log) != LOG_RECORD_SIZE) {
+            cerr << "Error: Failed writing " << logPath << endl;
+            return false;
+        }
+        ++sequence;
+        board.submit(playerId, score, timestamp);
+
+        if (++sinceSnapshot >= snapshotEvery)
+            return snapshot();
+        return true;
+    }
+
+    bool flush() {
+        if (log && fflush(log) != 0) {
+            cerr << "Error: Failed writing " << logPath << endl;
+            return false;
+        }
+        return log != nullptr;
+    }
+
+    // Writes the ranked state to a temporary file, swaps it in and restarts the log
+    bool snapshot() {
+        string tmpPath = snapPath + ".tmp";
+        FILE* out = fopen(tmpPath.c_str(), "wb");
+        if (!out) {
+            cerr << "Error: Could not open " << tmpPath << " for writing." << endl;
+            return false;
+        }
+
+        vector<LeaderboardEntry> ranked;
+        board.topK(board.size(), ranked);
+        vector<unsigned char> body(ranked.size() * SNAP_ENTRY_SIZE);
+        for (size_t i = 0; i < ranked.size(); ++i)
+            encodeEntry(ranked[i], &body[i * SNAP_ENTRY_SIZE]);
+
+        unsigned char header[SNAP_HEADER_SIZE] = {};
+        unsigned long long count = ranked.size();
+        memcpy(header, SNAP_MAGIC, 4);
+        memcpy(header + 4, &SNAP_FORMAT, 4);
+        memcpy(header + 8, &count, 8);
+        memcpy(header + 16, &sequence, 8);
+        unsigned int crc = crc32(body.data(), body.size(), crc32(header, 24));
+        memcpy(header + 24, &crc, 4);
+
+        bool ok = fwrite(header, 1, SNAP_HEADER_SIZE, out) == SNAP_HEADER_SIZE
+            && fwrite(body.data(), 1, body.size(), out) == body.size()
+            && fflush(out) == 0 && syncFile(out);
+        ok = fclose(out) == 0 && ok;
+        if (!ok) {
+            cerr << "Error: Failed writing " << tmpPath << endl;
+            remove(tmpPath.c_str());
+            return false;
+        }
+
+        // Records up to `sequence` are now in the snapshot; a crash before the log is
+        // restarted only leaves records that replayLog skips by sequence number
+        std::error_code ec;
+        filesystem::rename(tmpPath, snapPath, ec);
+        if (ec) {
+            cerr << "Error: Could not replace " << snapPath << ": " << ec.message() << endl;
+            return false;
+        }
+        // The old log must not be truncated until the rename itself is on disk
+        if (!syncDirectory(snapPath)) {
+            cerr << "Error: Could not sync the directory of " << snapPath << endl;
+            return false;
+        }
+        if (log)
+            fclose(log);
+        log = fopen(logPath.c_str(), "wb");
+        if (!log) {
+            cerr << "Error: Could not open " << logPath << " for writing." << endl;
+            return false;
+        }
+        setvbuf(log, nullptr, _IOFBF, 1 << 16);
+        sinceSnapshot = 0;
+        return true;
+    }
+
+private:
+    static const size_t LOG_RECORD_SIZE = 32;
+    static const size_t SNAP_HEADER_SIZE = 32;
+    static const size_t SNAP_ENTRY_SIZE = 24;
+    static constexpr const char* SNAP_MAGIC = "LBSN";
+    static const unsigned int SNAP_FORMAT = 1;
+
+    Leaderboard& board;
+    string logPath;
+    string snapPath;
+    int snapshotEvery;
+    int sinceSnapshot;
+    unsigned long long sequence;   // last sequence number written or recovered
+    FILE* log;
+
+    static bool syncFile(FILE* file) {
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    // Makes a rename into the file's directory durable; Windows has no directory handles
+    // to sync and its renames need no extra step
+    static bool syncDirectory(const string& path) {
+#ifdef _WIN32
+        (void)path;
+        return true;
+#else
+        filesystem::path directory = filesystem::path(path).parent_path();
+        int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        bool ok = fsync(fd) == 0;
+        return close(fd) == 0 && ok;
+#endif
+    }
+
+    // entry layout: timestamp (8) score (8) player id (4) padding (4)
+    static void encodeEntry(const LeaderboardEntry& entry, unsigned char* out) {
+        memset(out, 0, SNAP_ENTRY_SIZE);
+        memcpy(out, &entry.timestamp, 8);
+        memcpy(out + 8, &entry.score, 8);
+        memcpy(out + 16, &entry.playerId, 4);
+    }
+
+    static void decodeEntry(const unsigned char* in, LeaderboardEntry& entry) {
+        memcpy(&entry.timestamp, in, 8);
+        memcpy(&entry.score, in + 8, 8);
+        memcpy(&entry.playerId, in + 16, 4);
+    }
+
+    // record layout: sequence (8) then the entry's first 20 bytes, then CRC of the first 28
+    static void encodeRecord(unsigned long long seq, const LeaderboardEntry& entry, unsigned char* out) {
+        unsigned char fields[SNAP_ENTRY_SIZE];
+        encodeEntry(entry, fields);
+        memcpy(out, &seq, 8);
+        memcpy(out + 8, fields, 20);
+        unsigned int crc = crc32(out, 28);
+        memcpy(out + 28, &crc, 4);
+    }
+
+    void loadSnapshot() {
+        ifstream in(snapPath, ios::binary);
+        if (!in.is_open())
+            return;
+
+        unsigned char header[SNAP_HEADER_SIZE];
+        unsigned int format, storedCrc;
+        unsigned long long count, lastSequence;
+        if (!in.read((char*)header, SNAP_HEADER_SIZE) || memcmp(header, SNAP_MAGIC, 4) != 0) {
+            cerr << "Error: " << snapPath << " is not a leaderboard snapshot." << endl;
+            return;
+        }
+        memcpy(&format, header + 4, 4);
+        memcpy(&count, header + 8, 8);
+        memcpy(&lastSequence, header + 16, 8);
+        memcpy(&storedCrc, header + 24, 4);
+        if (format != SNAP_FORMAT) {
+            cerr << "Error: Unsupported snapshot format " << format << endl;
+            return;
+        }
+
+        // The header is not covered by anything yet, so check the count against the file
+        // before trusting it with an allocation
+        std::error_code ec;
+        unsigned long long fileSize = filesystem::file_size(snapPath, ec);
+        if (ec || count > (fileSize - SNAP_HEADER_SIZE) / SNAP_ENTRY_SIZE) {
+            cerr << "Error: " << snapPath << " is corrupt, ignoring it." << endl;
+            return;
+        }
+
+        vector<unsigned char> body(count * SNAP_ENTRY_SIZE);
+        if (!in.read((char*)body.data(), body.size()) || crc32(body.data(), body.size(), crc32(header, 24)) != storedCrc) {
+            cerr << "Error: " << snapPath << " is corrupt, ignoring it." << endl;
+            return;
+        }
+
+        vector<LeaderboardEntry> ranked(count);
+        for (size_t i = 0; i < count; ++i)
+            decodeEntry(&body[i * SNAP_ENTRY_SIZE], ranked[i]);
+        board.loadRanked(ranked);
+        sequence = lastSequence;
+    }
+
+    void replayLog() {
+        ifstream in(logPath, ios::binary);
+        if (!in.is_open())
+            return;
+
+        unsigned char record[LOG_RECORD_SIZE];
+        unsigned long long goodBytes = 0;
+        while (in.read((char*)record, LOG_RECORD_SIZE)) {
+            unsigned int storedCrc;
+            memcpy(&storedCrc, record + 28, 4);
+            if (crc32(record, 28) != storedCrc)
+                break;
+
+            unsigned long long seq;
+            memcpy(&seq, record, 8);
+            unsigned char fields[SNAP_ENTRY_SIZE] = {};
+            memcpy(fields, record + 8, 20);
+            LeaderboardEntry entry;
+            decodeEntry(fields, entry);
+            if (seq > sequence) {
+                board.submit(entry.playerId, entry.score, entry.timestamp);
+                sequence = seq;
+                ++sinceSnapshot;
+            }
+            goodBytes += LOG_RECORD_SIZE;
+        }
+        in.close();
+
+        // Cut off a torn or corrupt tail so new records follow the last good one
+        std::error_code ec;
+        if (goodBytes != filesystem::file_size(logPath, ec) && !ec) {
+            cerr << "Warning: Dropping damaged tail of " << logPath << endl;
+            filesystem::resize_file(logPath, goodBytes, ec);
+        }
+    }
+};
+
+// Recorded player paths packed back to back: path i is tiles[offsets[i] .. offsets[i + 1])
+struct PathBatch {
+    vector<int> tiles;
+    vector<int> offsets;
+
+    PathBatch() : offsets(1, 0) {}
+
+    void add(const vector<int>& path) {
+        tiles.insert(tiles.end(), path.begin(), path.end());
+        offsets.push_back(tiles.size());
+    }
+
+    int size() const {
+        return offsets.size() - 1;
+    }
+};
+
+// How one recorded path compares with the shortest path between its first and last tile
+struct PathScore {
+    double score;          // 100 * shortest path tiles / player path tiles, as in calculateScore
+    double optimality;     // shortest cost / player cost, 0 when the path is not walkable
+    int editDistance;      // tile insertions, deletions and substitutions away from the shortest path
+    double offPathRatio;   // fraction of player tiles that are not on the shortest path
+    int invalidSteps;      // moves between tiles with no edge (standing still is allowed)
+};
+
+// Per-thread buffers for batch scoring
+struct ScoreScratch {
+    PathScratch search;
+    vector<int> shortest;
+    vector<int> onShortest;   // stamp per vertex, equal to `stamp` when on the current shortest path
+    int stamp;
+    vector<int> row;
+    vector<int> nextRow;
+
+    ScoreScratch() : stamp(0) {}
+};
+
+int edgeWeight(const CsrGraph& graph, int from, int to) {
+    for (int e = graph.offsets[from]; e < graph.offsets[from + 1]; ++e) {
+        if (graph.targets[e] == to)
+            return graph.weights[e];
+    }
+    return -1;
+}
+
+// Levenshtein distance with two rows; the substitution/deletion pass has no
+// loop-carried dependency so it vectorizes, leaving only the insertion pass serial
+int editDistance(const int* a, int n, const int* b, int m, ScoreScratch& scratch) {
+    vector<int>& row = scratch.row;
+    vector<int>& next = scratch.nextRow;
+    row.resize(m + 1);
+    next.resize(m + 1);
+    for (int j = 0; j <= m; ++j)
+        row[j] = j;
+
+    for (int i = 1; i <= n; ++i) {
+        int tile = a[i - 1];
+        int* cur = next.data();
+        const int* up = row.data();
+        cur[0] = i;
+        for (int j = 1; j <= m; ++j)
+            cur[j] = min(up[j] + 1, up[j - 1] + (tile != b[j - 1] ? 1 : 0));
+        for (int j = 1; j <= m; ++j)
+            cur[j] = min(cur[j], cur[j - 1] + 1);
+        row.swap(next);
+    }
+    return row[m];
+}
+
+// Scores every path in `order[first, last)`; all of them start on the same tile, sorted by goal
+void scorePathGroup(const CsrGraph& graph, const PathBatch& batch, const vector<int>& order, int first, int last,
+                    vector<PathScore>& scores, ScoreScratch& scratch) {
+    int start = batch.tiles[batch.offsets[order[first]]];
+    dijkstra(graph, start, scratch.search);
+    scratch.onShortest.resize(graph.vertexCount(), 0);
+
+    int currentGoal = -1;
+    for (int k = first; k < last; ++k) {
+        int id = order[k];
+        const int* path = &batch.tiles[batch.offsets[id]];
+        int n = batch.offsets[id + 1] - batch.offsets[id];
+        int goal = path[n - 1];
+        PathScore& result = scores[id];
+        int best = scratch.search.dist[goal];
+
+        if (goal != currentGoal) {
+            currentGoal = goal;
+            ++scratch.stamp;
+            scratch.shortest.clear();
+            if (best != INF)
+                buildPath(scratch.search.prev, goal, scratch.shortest);
+            for (int tile : scratch.shortest)
+                scratch.onShortest[tile] = scratch.stamp;
+        }
+
+        long long cost = 0;
+        int offPath = 0;
+        result.invalidSteps = 0;
+        for (int i = 0; i < n; ++i) {
+            if (scratch.onShortest[path[i]] != scratch.stamp)
+                ++offPath;
+            if (i > 0 && path[i] != path[i - 1]) {
+                int w = edgeWeight(graph, path[i - 1], path[i]);
+                if (w < 0)
+                    ++result.invalidSteps;
+                else
+                    cost += w;
+            }
+        }
+
+        int m = scratch.shortest.size();
+        result.score = best == INF ? 0.0 : 100.0 * m / n;
+        result.optimality = best == INF || result.invalidSteps > 0 ? 0.0 : (cost == 0 ? 1.0 : double(best) / cost);
+        result.editDistance = editDistance(path, n, scratch.shortest.data(), m, scratch);
+        result.offPathRatio = double(offPath) / n;
+    }
+}
+
+// Function to score many recorded paths at once. Paths are grouped by start tile so each
+// group needs a single search, and groups are shared out between threadCount workers.
+// A run with a tile outside the graph is not searched: it scores 0 with every tile off
+// path, and each outside tile counts as an invalid step.
+void scorePathBatch(const CsrGraph& graph, const PathBatch& batch, vector<PathScore>& scores, int threadCount) {
+    int count = batch.size();
+    scores.assign(count, PathScore());
+
+    vector<int> order;
+    for (int i = 0; i < count; ++i) {
+        int n = batch.offsets[i + 1] - batch.offsets[i];
+        if (n == 0)
+            continue;
+        int outside = 0;
+        for (int k = batch.offsets[i]; k < batch.offsets[i + 1]; ++k) {
+            if (batch.tiles[k] < 0 || batch.tiles[k] >= graph.vertexCount())
+                ++outside;
+        }
+        if (outside > 0)
+            scores[i] = {0.0, 0.0, n, 1.0, outside};
+        else
+            order.push_back(i);
+    }
+    auto firstTile = [&](int i) { return batch.tiles[batch.offsets[i]]; };
+    auto lastTile = [&](int i) { return batch.tiles[batch.offsets[i + 1] - 1]; };
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        if (firstTile(a) != firstTile(b))
+            return firstTile(a) < firstTile(b);
+        return lastTile(a) < lastTile(b);
+    });
+
+    vector<int> groupStarts;
+    for (size_t k = 0; k < order.size(); ++k) {
+        if (k == 0 || firstTile(order[k]) != firstTile(order[k - 1]))
+            groupStarts.push_back(k);
+    }
+    groupStarts.push_back(order.size());
+
+    int groupCount = groupStarts.size() - 1;
+    atomic<int> nextGroup(0);
+    auto worker = [&]() {
+        ScoreScratch scratch;
+        for (int g = nextGroup++; g < groupCount; g = nextGroup++)
+            scorePathGroup(graph, batch, order, groupStarts[g], groupStarts[g + 1], scores, scratch);
+    };
+
+    threadCount = max(1, min(threadCount, groupCount));
+    vector<thread> workers;
+    for (int t = 1; t < threadCount; ++t)
+        workers.emplace_back(worker);
+    worker();
+    for (thread& t : workers)
+        t.join();
+}
+
+// Builds a side x side 4-connected grid with random weights in [1, 9]
+CsrGraph makeGridGraph(int side, unsigned int seed) {
+    mt19937 rng(seed);
+    uniform_int_distribution<int> weight(1, 9);
+    CsrGraphBuilder builder(side * side);
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            int u = y * side + x;
+            if (x + 1 < side) {
+                builder.addEdge(u, u + 1, weight(rng));
+                builder.addEdge(u + 1, u, weight(rng));
+            }
+            if (y + 1 < side) {
+                builder.addEdge(u, u + side, weight(rng));
+                builder.addEdge(u + side, u, weight(rng));
+            }
+        }
+    }
+    return builder.build();
+}
+
+// Times a full single-source search with one open list, best of a few runs
+template <class OpenList>
+void benchmarkOpenList(const char* name, const CsrGraph& graph, const vector<int>& expected) {
+    SearchScratch<OpenList> scratch;
+    double best = 1e30;
+    for (int run = 0; run < 3; ++run) {
+        auto begin = chrono::steady_clock::now();
+        dijkstra(graph, 0, scratch);
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count());
+    }
+    cout << name << ": " << best << " ms" << (scratch.dist == expected ? "" : " (MISMATCH)") << endl;
+}
+
+// Compares the open lists on a 1000 x 1000 grid (run as: shortestPath bench)
+void benchmarkOpenLists() {
+    int side = 1000;
+    CsrGraph graph = makeGridGraph(side, 42);
+    SearchScratch<LazyBinaryHeap> reference;
+    dijkstra(graph, 0, reference);
+
+    cout << "Dijkstra on a " << side << "x" << side << " grid:" << endl;
+    benchmarkOpenList<LazyBinaryHeap>("Lazy binary heap", graph, reference.dist);
+    benchmarkOpenList<QuadHeap>("Indexed 4-ary heap", graph, reference.dist);
+    benchmarkOpenList<RadixHeap>("Radix heap", graph, reference.dist);
+}
+
+// Submits a million runs and times updates, rank queries and top-K reads
+void benchmarkLeaderboard() {
+    int players = 1000000;
+    mt19937 rng(7);
+    uniform_real_distribution<double> score(0.0, 100.0);
+    Leaderboard leaderboard;
+
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < players; ++i)
+        leaderboard.submit(i, score(rng), i);
+    for (int i = 0; i < players; ++i)
+        leaderboard.submit(rng() % players, score(rng), players + i);
+    double submitMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    begin = chrono::steady_clock::now();
+    long long rankSum = 0;
+    for (int i = 0; i < players; ++i)
+        rankSum += leaderboard.rankOf(rng() % players);
+    double rankMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    begin = chrono::steady_clock::now();
+    double topSum = 0;
+    for (int i = 0; i < players; ++i)
+        topSum += leaderboard.top()[0].score;
+    double topMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    cout << "Leaderboard with " << leaderboard.size() << " players: " << 2 * players << " submits " << submitMs
+         << " ms, " << players << " rank queries " << rankMs << " ms, " << players << " top reads " << topMs
+         << " ms" << (rankSum > 0 && topSum > 0 ? "" : " (unexpected)") << endl;
+}
+
+// Times logged submissions and recovery (snapshot load plus log tail replay)
+void benchmarkLeaderboardStore() {
+    string base = "bench_leaderboard";
+    int submissions = 500000;
+    mt19937 rng(11);
+    uniform_real_distribution<double> score(0.0, 100.0);
+    remove((base + ".log").c_str());
+    remove((base + ".snap").c_str());
+
+    double submitMs;
+    {
+        Leaderboard board;
+        LeaderboardStore store(board, base, 200000);
+        if (!store.open())
+            return;
+        auto begin = chrono::steady_clock::now();
+        for (int i = 0; i < submissions; ++i) {
+            if (!store.submit(rng() % 300000, score(rng), i))
+                return;
+            if (i % 1000 == 999 && !store.flush())
+                return;
+        }
+        if (!store.flush())
+            return;
+        submitMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    }
+
+    Leaderboard recovered;
+    LeaderboardStore store(recovered, base, 200000);
+    auto begin = chrono::steady_clock::now();
+    if (!store.open())
+        return;
+    double recoverMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    cout << "Leaderboard store: " << submissions << " logged submits " << submitMs << " ms ("
+         << (long long)(submissions / (submitMs / 1000)) << "/s), recovered " << recovered.size()
+         << " players in " << recoverMs << " ms" << endl;
+    remove((base + ".log").c_str());
+    remove((base + ".snap").c_str());
+}
+
+// Checks that damaged snapshots are ignored on open instead of loaded or trusted
+void checkDamagedSnapshots() {
+    string base = "check_leaderboard";
+    Leaderboard board;
+    for (int i = 0; i < 100; ++i)
+        board.submit(i, i, i);
+    {
+        LeaderboardStore store(board, base, 1000);
+        if (!store.open() || !store.snapshot())
+            return;
+    }
+    remove((base + ".log").c_str());
+
+    // Truncated: the header promises 100 entries, half are there
+    string snap = base + ".snap";
+    std::error_code ec;
+    filesystem::resize_file(snap, filesystem::file_size(snap, ec) / 2, ec);
+    Leaderboard truncated;
+    LeaderboardStore truncatedStore(truncated, base);
+    truncatedStore.open();
+
+    // Inflated: a count far beyond the file, which must not reach the allocator
+    FILE* out = fopen(snap.c_str(), "r+b");
+    unsigned long long count = 1ULL << 60;
+    bool written = out && fseek(out, 8, SEEK_SET) == 0 && fwrite(&count, 8, 1, out) == 1;
+    if (out)
+        fclose(out);
+    Leaderboard inflated;
+    LeaderboardStore inflatedStore(inflated, base);
+    inflatedStore.open();
+
+    cout << "Damaged snapshots: truncated loaded " << truncated.size() << ", inflated loaded " << inflated.size()
+         << (written && truncated.size() == 0 && inflated.size() == 0 ? "" : " (unexpected)") << endl;
+    remove((base + ".log").c_str());
+    remove(snap.c_str());
+}
+
+// Scores recorded random-walk runs from a handful of spawn points on a 300 x 300 grid
+void benchmarkPathScoring() {
+    int side = 300;
+    int runs = 20000;
+    CsrGraph graph = makeGridGraph(side, 5);
+    mt19937 rng(9);
+
+    PathBatch batch;
+    vector<int> path;
+    for (int r = 0; r < runs; ++r) {
+        int spawn = r % 16;
+        int at = (side / 2) * side + spawn * (side / 16);
+        path.assign(1, at);
+        int steps = 50 + rng() % 100;
+        for (int i = 0; i < steps; ++i) {
+            int degree = graph.offsets[at + 1] - graph.offsets[at];
+            at = graph.targets[graph.offsets[at] + rng() % degree];
+            path.push_back(at);
+        }
+        batch.add(path);
+    }
+
+    vector<PathScore> scores;
+    int threads = max(1u, thread::hardware_concurrency());
+    auto begin = chrono::steady_clock::now();
+    scorePathBatch(graph, batch, scores, threads);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    double meanOptimality = 0;
+    for (const PathScore& score : scores)
+        meanOptimality += score.optimality / runs;
+    cout << "Batch scoring: " << runs << " runs on " << threads << " threads in " << ms
+         << " ms, mean optimality " << meanOptimality << endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        benchmarkOpenLists();
+        benchmarkLeaderboard();
+        benchmarkLeaderboardStore();
+        checkDamagedSnapshots();
+        benchmarkPathScoring();
+        return 0;
+    }
+
+    // Example graph representation (compressed sparse rows)
     int V = 10; // Number of tiles
-    vector<vector<Edge>> graph(V);
-
-    graph[0].push_back({1, 1});
-    graph[0].push_back({2, 3});
-    graph[1].push_back({3, 4}); 
-    graph[1].push_back({4, 2});
-    graph[2].push_back({5, 2});
-    graph[3].push_back({6, 5}); 
-    graph[3].push_back({7, 2});
-    graph[4].push_back({8, 3});
-    graph[5].push_back({8, 1}); 
-    graph[5].push_back({9, 4});
-    graph[6].push_back({9, 2});
-    graph[7].push_back({9, 3});
-    graph[8].push_back({9, 1});
+    CsrGraphBuilder builder(V);
+
+    builder.addEdge(0, 1, 1);
+    builder.addEdge(0, 2, 3);
+    builder.addEdge(1, 3, 4);
+    builder.addEdge(1, 4, 2);
+    builder.addEdge(2, 5, 2);
+    builder.addEdge(3, 6, 5);
+    builder.addEdge(3, 7, 2);
+    builder.addEdge(4, 8, 3);
+    builder.addEdge(5, 8, 1);
+    builder.addEdge(5, 9, 4);
+    builder.addEdge(6, 9, 2);
+    builder.addEdge(7, 9, 3);
+    builder.addEdge(8, 9, 1);
+
+    CsrGraph graph = builder.build();
 
     // Source and target nodes
     int start = 0;
@@ -126,21 +1719,83 @@ int main() {
     // You can create variations of extended paths similarly
 };
 
-    // Calculate score for each user path and store in a max heap
-    priority_queue<double> leaderboard;
+    // Calculate score for each user path and record it on the leaderboard,
+    // which is kept on disk so earlier runs of the program are remembered
+    Leaderboard leaderboard;
+    LeaderboardStore leaderboardStore(leaderboard, "leaderboard");
+    bool persisted = leaderboardStore.open();
 
     for (int i = 0; i < samplePaths.size(); ++i) {
         double score = calculateScore(prev, samplePaths[i]);
 
-        // Store score in the max heap
-        leaderboard.push(score);
+        // Player i finished run i; without the store it is only ranked for this run
+        if (!persisted || !leaderboardStore.submit(i, score, i))
+            leaderboard.submit(i, score, i);
+    }
+    if (persisted && !leaderboardStore.flush())
+        cerr << "Error: Scores from this run may not be saved." << endl;
+
+    // Detailed end-of-tournament scoring of the same runs
+    PathBatch runs;
+    for (const vector<int>& path : samplePaths)
+        runs.add(path);
+    vector<PathScore> runScores;
+    scorePathBatch(graph, runs, runScores, 2);
+    for (int i = 0; i < runs.size(); ++i) {
+        cout << "Run " << i << ": score " << runScores[i].score << ", optimality " << runScores[i].optimality
+             << ", edit distance " << runScores[i].editDistance << ", off path " << runScores[i].offPathRatio * 100
+             << "%, invalid steps " << runScores[i].invalidSteps << endl;
     }
 
     // Display leaderboard
     cout << "Leaderboard:" << endl;
-    while (!leaderboard.empty()) {
-        cout << leaderboard.top() << endl;
-        leaderboard.pop();
+    for (const LeaderboardEntry& entry : leaderboard.top()) {
+        cout << "#" << leaderboard.rankOf(entry.playerId) << " Player " << entry.playerId << ": " << entry.score << endl;
+    }
+
+    // Navigation graph for the level edited in the level editor
+    vector<vector<int>> tiles;
+    if (loadTileMap("level_config.txt", tiles)) {
+        TileGraph level = tileMapToCsr(tiles);
+        cout << "Level graph: " << level.graph.vertexCount() << " cells, " << level.graph.edgeCount() << " edges" << endl;
+
+        // Agents walking from the left edge to the right edge share cached routes
+        PathCache cache(1 << 20);
+        PathScratch scratch;
+        PathResult route;
+        unsigned int levelVersion = 1;
+        int goal = level.cellId(level.width - 1, 0);
+        findPathCached(cache, levelVersion, level.graph, scratch, level.cellId(0, 0), goal, route);
+        findPathCached(cache, levelVersion, level.graph, scratch, level.cellId(0, 0), goal, route);
+        findPathCached(cache, levelVersion, level.graph, scratch, level.cellId(5, 0), goal, route);
+        cache.invalidateRegion(level.width, 0, 5, level.width - 1, 5, 1, levelVersion, levelVersion + 1);
+        ++levelVersion;
+        findPathCached(cache, levelVersion, level.graph, scratch, level.cellId(2, 0), goal, route);
+
+        const PathCacheStats& stats = cache.getStats();
+        cout << "Path cache: " << stats.hits << " hits, " << stats.suffixHits << " suffix hits, " << stats.misses
+             << " misses, hit rate " << stats.hitRate() * 100 << "%, " << stats.bytes << " bytes" << endl;
+    }
+
+    // Asynchronous queries: the duplicate (0, 9) request shares one search
+    PathService service(graph, 2, 2000);
+    vector<PathHandle> handles = {service.request(0, 9), service.request(2, 9), service.request(0, 9)};
+    vector<bool> printed(handles.size(), false);
+    size_t remaining = handles.size();
+    while (remaining > 0) {
+        service.update();
+        for (size_t i = 0; i < handles.size(); ++i) {
+            PathResult result;
+            if (!printed[i] && service.poll(handles[i], result)) {
+                cout << "Async path " << handles[i]->start << " -> " << handles[i]->goal << " cost " << result.cost << ":";
+                for (int tile : result.path)
+                    cout << " " << tile;
+                cout << endl;
+                printed[i] = true;
+                --remaining;
+            }
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
     }
 
     return 0;